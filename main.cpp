@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -8,70 +9,420 @@
 #include <random>
 #include <limits>
 #include <algorithm>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
+#include <cmath>
+#include <filesystem>
+#include <unordered_set>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
 #include <windows.h>
 using namespace std;
+class Money {
+public:
+    Money();
+    static Money fromCents(long long cents);
+    static Money fromDollars(long long dollars);
+    static bool parse(const char* text, size_t length, Money& result);
+    static bool parse(const string& text, Money& result);
+    long long cents() const;
+    string toString() const;
+    Money operator+(Money other) const;
+    Money operator-(Money other) const;
+    Money operator-() const;
+    Money& operator+=(Money other);
+    Money& operator-=(Money other);
+    bool operator==(Money other) const;
+    bool operator!=(Money other) const;
+    bool operator<(Money other) const;
+    bool operator<=(Money other) const;
+    bool operator>(Money other) const;
+    bool operator>=(Money other) const;
+private:
+    long long value;
+};
+ostream& operator<<(ostream& out, Money amount);
 struct Transaction {
     string timestamp;
     string accountNumber;
     string type;
-    double amount;
-    double balance;
+    Money amount;
+    Money balance;
+    string hash;
     string toJson() const;
-    static Transaction fromJson(const string& jsonStr);
+    string kind() const;
+    string canonical() const;
+    string chainHash(const string& previous) const;
+    static bool fromJson(const string& jsonStr, Transaction& trans);
+};
+enum class AccountType : unsigned char {
+    Savings,
+    Current,
+    Fixed
+};
+class Sha256 {
+public:
+    Sha256();
+    void update(const char* data, size_t length);
+    void update(const string& data);
+    string digest();
+    static string toHex(const string& bytes);
+    static string hash(const string& data);
+    static string hmac(const string& key, const string& message);
+private:
+    static const unsigned int ROUND_CONSTANTS[64];
+    unsigned int state[8];
+    unsigned char buffer[64];
+    size_t bufferLength;
+    unsigned long long totalLength;
+    void transform(const unsigned char* block);
+};
+struct LedgerCheckpoint {
+    size_t sequence;
+    string hash;
+    string signature;
+};
+struct LedgerAudit {
+    size_t records;
+    size_t checkpoints;
+    size_t segments;
+    size_t unsealed;
+    vector<string> failures;
+};
+class StringPool {
+public:
+    static StringPool& instance();
+    unsigned int add(const string& value);
+    unsigned int intern(const string& value);
+    string_view get(unsigned int handle) const;
+    size_t bytesUsed() const;
+private:
+    static const size_t CHUNK_SIZE = 1 << 20;
+    static const size_t MAX_CHUNKS = 4096;
+    unique_ptr<char[]> chunks[MAX_CHUNKS];
+    size_t used;
+    unordered_map<unsigned long long, unsigned int> interned;
+    mutex lock;
+    StringPool();
+    unsigned int append(const string& value);
+};
+struct AggregateSummary;
+struct TransferRequest {
+    string fromAccount;
+    string toAccount;
+    Money amount;
+};
+struct BatchResult {
+    bool applied;
+    vector<string> errors;
+};
+struct LedgerPosition {
+    int shard;
+    size_t sequence;
+};
+struct ArchiveStats {
+    size_t records;
+    size_t jsonBytes;
+    size_t archiveBytes;
 };
 class User {
 private:
-    string accountNumber;
-    string username;
-    string password;
-    string name;
-    string accountType;  
-    string cardNumber;
-    string cardPin;
-    double balance;
-    bool hasCard; 
+    unsigned int accountId;
+    unsigned int username;
+    unsigned int password;
+    unsigned int name;
+    unsigned long long cardNumber;
+    Money balance;
+    char cardPin[4];
+    AccountType accountType;
+    bool hasCard;
+    static atomic<unsigned int> lastAccountId;
     
 public:
     User();
     User(string username, string password, string name, string accountType);
     string getAccountNumber() const;
-    string getUsername() const;
-    string getName() const;
+    string_view getUsername() const;
+    string_view getName() const;
     string getAccountType() const;
+    AccountType getAccountTypeCode() const;
     string getCardNumber() const;
-    double getBalance() const;
+    Money getBalance() const;
     bool getHasCard() const;
-    bool checkPassword(string password) const;
-    bool checkCardPin(string pin) const;
-    void deposit(double amount);
-    bool withdraw(double amount);
-    void requestATMCard();
+    bool checkPassword(const string& password) const;
+    bool checkCardPin(const string& pin) const;
+    bool matchesCard(const string& cardNumber) const;
+    unsigned long long getCardDigits() const;
+    void deposit(Money amount);
+    bool withdraw(Money amount);
+    string issueCard();
     void changeCardPin(string newPin);
     string toJson() const;
-    static User fromJson(const string& jsonStr);
+    static bool fromJson(const string& jsonStr, User& user);
+    static AccountType parseAccountType(const string& accountType);
+    static const char* accountTypeName(AccountType accountType);
+    static unsigned long long parseCardNumber(const string& cardNumber);
 private:
-    string generateAccountNumber();
-    string generateCardNumber();
-    string generateCardPin();
+    static unsigned int parseAccountNumber(const string& accountNumber);
+    static void observeAccountId(unsigned int accountId);
+    unsigned int generateAccountNumber();
+    unsigned long long generateCardNumber();
+    void generateCardPin();
 };
 class FileHandler {
 public:
     static void saveUser(const User& user);
     static void saveAllUsers(const vector<User>& users);
     static vector<User> loadAllUsers();
-    static void saveTransaction(const User& user, const string& type, double amount);
+    static vector<User> loadAllUsers(bool& intact);
+    static LedgerPosition saveTransaction(const Transaction& trans);
     static vector<string> loadTransactions(const string& accountNumber);
+    static vector<Transaction> loadAllTransactions();
+    static Transaction makeTransaction(const User& user, const string& type, Money amount);
+    static time_t parseTimestamp(const string& timestamp);
+    static bool commitBatch(const vector<User>& users, const vector<Transaction>& transactions, vector<LedgerPosition>& positions);
+    static void recoverJournal();
+    static int getShardCount();
+    static int shardOf(const string& accountNumber);
+    static bool rebalanceShards(int newCount);
+    static void setDataDirectory(const string& directory);
+    static string dataPath(const string& file);
+    static string getCurrentTimestamp();
+    static bool loadTransferBatch(const string& path, vector<TransferRequest>& requests, vector<string>& errors);
+    static vector<Transaction> loadLedgerShard(int shard);
+    static vector<Transaction> loadLedgerShard(int shard, bool& intact);
+    static bool readLedgerShard(int shard, size_t limit, const function<void(const Transaction&)>& visit);
+    static vector<size_t> getLedgerSizes();
+    static string formatTimestamp(time_t when);
+    static ArchiveStats archiveTransactions(time_t cutoff);
+    static void scanArchives(const function<void(const Transaction&)>& visit);
+    static void saveAggregates(const AggregateSummary& summary);
+    static bool loadAggregates(AggregateSummary& summary);
+    static bool aggregatesCurrent(const AggregateSummary& summary);
+    static LedgerAudit verifyLedger(bool adopting);
+    static bool adoptUnsealedRecords();
+    static bool generateLedgerKey(const string& path);
 private:
     static const string USERS_FILE;
     static const string TRANSACTIONS_FILE;
-    static string getCurrentTimestamp();
-    static vector<Transaction> loadAllTransactions();
-    static void saveAllTransactions(const vector<Transaction>& transactions);
+    static const string SHARDS_CONFIG_FILE;
+    static const string JOURNAL_FILE;
+    static const string ARCHIVE_FILE;
+    static const string AGGREGATES_FILE;
+    static const string CHECKPOINTS_FILE;
+    static const string HEAD_FILE;
+    static const string LEDGER_KEY_ENV;
+    static const string TEMP_SUFFIX;
+    static const string BATCH_SUFFIX;
+    static const string LEDGER_GENESIS;
+    static const size_t CHECKPOINT_INTERVAL = 1024;
+    static const int AGGREGATES_VERSION = 3;
+    static string dataDirectory;
+    static int shardCount;
+    static const int SHARD_LOCKS = 64;
+    static mutex shardLocks[SHARD_LOCKS];
+    static vector<size_t> ledgerSizes;
+    static mutex ledgerSizesLock;
+    static mutex journalLock;
+    static mutex keyLock;
+    static mutex& shardLock(int shard);
+    static void setLedgerSize(int shard, size_t size);
+    static string shardFile(const string& file, int shard, int count);
+    static vector<User> loadUsersFrom(const string& path, bool& intact);
+    static vector<string> loadUserRows(const string& path);
+    static bool saveUserRows(const string& path, const vector<string>& rows);
+    static bool mergeUserRows(const string& path, const vector<User>& users);
+    static bool mergeUserRows(const string& path, const string& target, const vector<User>& users);
+    static vector<Transaction> loadTransactionsFrom(const string& path);
+    static vector<Transaction> loadTransactionsFrom(const string& path, bool& intact);
+    static bool readTransactions(istream& in, const string& path, size_t limit, const function<void(const Transaction&)>& visit);
+    static bool saveTransactionsTo(const string& path, const vector<Transaction>& transactions);
+    static void recoverArchives();
+    static bool applyBatch(const vector<User>& users, const vector<Transaction>& transactions, bool replay,
+                           vector<LedgerPosition>& positions, bool& written);
+    static bool isDataPath(const string& path);
+    static string ledgerKey();
+    static string signingKey();
+    static string signCheckpoint(const string& key, size_t sequence, const string& hash);
+    static string signHead(const string& key, size_t sequence, const string& hash);
+    static vector<LedgerCheckpoint> loadCheckpointsFrom(const string& path);
+    static vector<LedgerCheckpoint> loadCheckpoints(int shard);
+    static bool loadHead(int shard, LedgerCheckpoint& head);
+    static bool hasSeals(int shard, int count);
+    static string dataFingerprint();
+    static void appendCheckpoint(int shard, size_t sequence, const string& hash);
+    static void writeHead(int shard, const LedgerCheckpoint& head);
+    static bool sealLedger(int shard, vector<Transaction>& transactions, size_t fresh, bool adopt, LedgerCheckpoint& head);
+};
+struct UsageLimits {
+    Money hourlyWithdrawal;
+    Money dailyWithdrawal;
+    Money hourlyDeposit;
+    Money dailyDeposit;
+    int velocityCount;
+    int velocityMinutes;
+    UsageLimits();
+    bool set(const string& key, const string& value);
+};
+struct ATMLimits {
+    Money perWithdrawal;
+    Money perDeposit;
+    UsageLimits account;
+    UsageLimits card;
+    ATMLimits();
+    static ATMLimits load(const string& path);
+};
+class RollingWindow {
+public:
+    explicit RollingWindow(long long slotSeconds = 60);
+    void add(time_t now, Money amount);
+    Money total(time_t now, int slots) const;
+    int count(time_t now, int slots) const;
+    static const int SLOTS = 60;
+private:
+    long long slotSeconds;
+    long long epochs[SLOTS];
+    Money amounts[SLOTS];
+    int counts[SLOTS];
+};
+struct ATMUsage {
+    RollingWindow withdrawMinutes;
+    RollingWindow withdrawHours;
+    RollingWindow depositMinutes;
+    RollingWindow depositHours;
+    ATMUsage();
+};
+class ATMLimiter {
+public:
+    void configure(const ATMLimits& limits);
+    string check(const string& accountNumber, const string& cardNumber, const string& type, Money amount, time_t now) const;
+    void record(const string& accountNumber, const string& cardNumber, const string& type, Money amount, time_t now);
+    void rebuild(const vector<User>& users, const vector<Transaction>& transactions, time_t now);
+private:
+    ATMLimits limits;
+    unordered_map<string, ATMUsage> accountUsage;
+    unordered_map<string, ATMUsage> cardUsage;
+    mutable mutex lock;
+    string checkUsage(const ATMUsage& usage, const UsageLimits& scopeLimits, const string& scope, const string& type, Money amount, time_t now) const;
+};
+const size_t SNAPSHOT_PAGE_SIZE = 1024;
+class Snapshot {
+public:
+    Snapshot();
+    size_t accountCount() const;
+    void forEachAccount(const function<void(const User&)>& visit) const;
+    void forEachTransaction(const function<void(const Transaction&)>& visit) const;
+    void release();
+private:
+    friend class SnapshotStore;
+    vector<shared_ptr<const vector<User>>> pages;
+    size_t count;
+    vector<size_t> ledgerSizes;
+};
+class SnapshotStore {
+public:
+    SnapshotStore();
+    void reset(const vector<User>& users);
+    void publish(const vector<pair<size_t, User>>& accounts, const vector<LedgerPosition>& rows);
+    Snapshot open();
+private:
+    struct PendingCommit {
+        vector<pair<size_t, User>> accounts;
+        vector<LedgerPosition> rows;
+    };
+    vector<shared_ptr<vector<User>>> pages;
+    size_t count;
+    vector<size_t> ledgerSizes;
+    vector<PendingCommit> pending;
+    mutex lock;
+    void store(size_t index, const User& user);
+};
+class LedgerArchive {
+public:
+    static size_t recordCount(const string& path);
+    static bool append(const string& path, const vector<Transaction>& transactions);
+    static bool scan(const string& path, const string& accountNumber, const function<void(const Transaction&)>& visit);
+private:
+    static const size_t BLOCK_RECORDS = 4096;
+    static const size_t MAX_BLOCK_BYTES = 64 << 20;
+    static const long long MAX_TIMESTAMP = 253402300799LL;
+    static const char MAGIC[4];
+    static void putVarint(string& out, unsigned long long value);
+    static bool getVarint(const string& in, size_t& pos, unsigned long long& value);
+    static bool readVarint(istream& in, size_t& pos, unsigned long long& value);
+    static size_t readHeader(istream& in);
+    static unsigned long long zigzag(long long value);
+    static long long unzigzag(unsigned long long value);
+    static string encodeBlock(const Transaction* transactions, size_t count);
+    static bool decodeBlock(const string& block, const string& accountNumber, const function<void(const Transaction&)>& visit, size_t& records);
+    static string compress(const string& in);
+    static bool decompress(const string& in, string& out);
+};
+struct VolumeBucket {
+    long count;
+    Money amount;
+};
+struct AggregateSummary {
+    size_t ledgerRecords;
+    size_t accounts;
+    Money totalBalance;
+    map<string, Money> typeBalances;
+    map<string, size_t> typeAccounts;
+    vector<pair<string, Money>> topAccounts;
+    map<string, map<string, VolumeBucket>> daily;
+    string fingerprint;
+};
+class BankAggregates {
+public:
+    BankAggregates();
+    void reset(const vector<User>& users);
+    void updateAccount(size_t index, const User& user);
+    void recordTransaction(const Transaction& trans);
+    void restoreVolumes(const AggregateSummary& saved);
+    AggregateSummary summary(size_t topCount, const deque<User>& users) const;
+private:
+    static const int ACCOUNT_TYPES = 3;
+    static string dayOf(const string& timestamp);
+    mutable mutex lock;
+    vector<Money> balances;
+    vector<AccountType> types;
+    vector<char> placed;
+    set<pair<Money, size_t>> ranking;
+    Money totalBalance;
+    Money typeBalances[ACCOUNT_TYPES];
+    size_t typeAccounts[ACCOUNT_TYPES];
+    map<string, map<string, VolumeBucket>> daily;
+    size_t ledgerRecords;
+    void place(size_t index, const User& user);
 };
 class BankingSystem {
 private:
-    vector<User> users;
+    deque<User> users;
+    mutable shared_mutex registryLock;
     User* currentUser;
+    ATMLimiter atmLimiter;
+    unordered_map<string, size_t> accountIndex;
+    unordered_map<string, size_t> usernameIndex;
+    unordered_map<unsigned long long, size_t> cardIndex;
+    static const int ACCOUNT_LOCKS = 64;
+    mutex accountLocks[ACCOUNT_LOCKS];
+    SnapshotStore snapshots;
+    BankAggregates aggregates;
+    void publish(const vector<const User*>& touched, const vector<LedgerPosition>& rows);
+    size_t indexOf(const User* user) const;
+    mutex& lockFor(const User* user);
+    bool commitUser(User& user, const string& type, Money amount);
 public:
     BankingSystem();
     ~BankingSystem();
@@ -97,73 +448,379 @@ public:
     void atmDashboard();  
     void atmWithdraw();   
     void atmDeposit();    
+    User* findAccount(const string& accountNumber);
+    User* openAccount(const string& username, const string& password, const string& name, const string& accountType);
+    User* authenticate(const string& username, const string& password);
+    User* authenticateCard(const string& cardNumber, const string& pin);
+    bool depositTo(User& user, Money amount);
+    bool withdrawFrom(User& user, Money amount);
+    string atmTransaction(User& user, const string& type, Money amount);
+    string transferFunds(User& from, const string& targetAccount, Money amount);
+    string issueCard(User& user);
+    BatchResult batchTransfer(const vector<TransferRequest>& requests);
+    Snapshot openSnapshot();
+    AggregateSummary getAggregates(size_t topCount) const;
+};
+enum LoadOperation {
+    LOAD_LOGIN,
+    LOAD_ATM_LOGIN,
+    LOAD_DEPOSIT,
+    LOAD_WITHDRAW,
+    LOAD_ATM_WITHDRAW,
+    LOAD_ATM_DEPOSIT,
+    LOAD_TRANSFER,
+    LOAD_HISTORY,
+    LOAD_OPERATION_COUNT
+};
+struct LoadConfig {
+    long accounts;
+    int threads;
+    long operations;
+    double zipfExponent;
+    int shards;
+    double burstOperations;
+    double idleMillis;
+    int mix[LOAD_OPERATION_COUNT];
+    LoadConfig();
+    bool set(const string& option);
+};
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const LoadConfig& config);
+    void run();
+    static const char* operationName(int operation);
+private:
+    struct Account {
+        User* user;
+        string username;
+        string password;
+        string accountNumber;
+        string cardNumber;
+        string pin;
+    };
+    struct ClientStats {
+        vector<double> latencies[LOAD_OPERATION_COUNT];
+        long rejected[LOAD_OPERATION_COUNT];
+    };
+    LoadConfig config;
+    unique_ptr<BankingSystem> bank;
+    vector<Account> accounts;
+    vector<double> popularity;
+    void createAccounts();
+    size_t pickAccount(mt19937_64& gen) const;
+    bool execute(int operation, mt19937_64& gen);
+    void runClient(int client, ClientStats& stats);
+    void report(const vector<ClientStats>& stats, double seconds) const;
 };
-const string FileHandler::USERS_FILE = "data/users.json";
-const string FileHandler::TRANSACTIONS_FILE = "data/transaction.json";
+const string FileHandler::USERS_FILE = "users.json";
+const string FileHandler::TRANSACTIONS_FILE = "transaction.json";
+const string FileHandler::SHARDS_CONFIG_FILE = "shards.cfg";
+const string FileHandler::JOURNAL_FILE = "journal.json";
+const string FileHandler::ARCHIVE_FILE = "transaction.archive";
+const string FileHandler::TEMP_SUFFIX = ".tmp";
+const string FileHandler::BATCH_SUFFIX = ".batch";
+const string FileHandler::AGGREGATES_FILE = "aggregates.json";
+const string FileHandler::CHECKPOINTS_FILE = "ledger.checkpoints";
+const string FileHandler::HEAD_FILE = "ledger.head";
+const string FileHandler::LEDGER_KEY_ENV = "BANK_LEDGER_KEY_FILE";
+const string FileHandler::LEDGER_GENESIS(64, '0');
+string FileHandler::dataDirectory = "data";
+int FileHandler::shardCount = 0;
+mutex FileHandler::shardLocks[FileHandler::SHARD_LOCKS];
+vector<size_t> FileHandler::ledgerSizes;
+mutex FileHandler::ledgerSizesLock;
+mutex FileHandler::journalLock;
+mutex FileHandler::keyLock;
+const string ATM_LIMITS_FILE = "atm_limits.cfg";
+const size_t AGGREGATE_TOP_ACCOUNTS = 100;
 void setColor(int color);
-User::User() : balance(0.0), hasCard(false) {
-    accountNumber = generateAccountNumber();
+bool runAdminCommand(int argc, char* argv[]);
+void benchmarkUserMemory(long count);
+void benchmarkPayroll(long count);
+void printSnapshotReport(const Snapshot& snapshot);
+void printAdminReport(const AggregateSummary& summary, size_t topCount);
+void archiveLedger(const string& cutoffDate);
+void auditLedger();
+void sealUnsealedLedger();
+Money::Money() : value(0) {
+}
+Money Money::fromCents(long long cents) {
+    Money result;
+    result.value = cents;
+    return result;
+}
+Money Money::fromDollars(long long dollars) {
+    return fromCents(dollars * 100);
+}
+bool Money::parse(const char* text, size_t length, Money& result) {
+    const long long limit = numeric_limits<long long>::max() / 100 - 1;
+    size_t i = 0;
+    while (i < length && isspace(static_cast<unsigned char>(text[i]))) i++;
+    while (length > i && isspace(static_cast<unsigned char>(text[length - 1]))) length--;
+    bool negative = false;
+    if (i < length && (text[i] == '-' || text[i] == '+')) {
+        negative = text[i++] == '-';
+    }
+    long long whole = 0;
+    long long fraction = 0;
+    int digits = 0;
+    int fractionDigits = 0;
+    bool roundUp = false;
+    for (; i < length && text[i] >= '0' && text[i] <= '9'; ++i, ++digits) {
+        whole = whole * 10 + (text[i] - '0');
+        if (whole > limit) {
+            return false;
+        }
+    }
+    if (i < length && text[i] == '.') {
+        for (++i; i < length && text[i] >= '0' && text[i] <= '9'; ++i, ++fractionDigits) {
+            if (fractionDigits < 2) {
+                fraction = fraction * 10 + (text[i] - '0');
+            } else if (fractionDigits == 2) {
+                roundUp = text[i] >= '5';
+            }
+        }
+    }
+    if (digits + fractionDigits == 0) {
+        return false;
+    }
+    if (i < length && (text[i] == 'e' || text[i] == 'E')) {
+        string legacy(text, length);
+        char* end = nullptr;
+        double amount = strtod(legacy.c_str(), &end);
+        if (end != legacy.c_str() + legacy.size() || !(fabs(amount) < static_cast<double>(limit))) {
+            return false;
+        }
+        result = fromCents(llround(amount * 100));
+        return true;
+    }
+    if (i != length) {
+        return false;
+    }
+    if (fractionDigits == 1) {
+        fraction *= 10;
+    }
+    long long cents = whole * 100 + fraction + (roundUp ? 1 : 0);
+    result = fromCents(negative ? -cents : cents);
+    return true;
+}
+bool Money::parse(const string& text, Money& result) {
+    return parse(text.data(), text.size(), result);
+}
+long long Money::cents() const {
+    return value;
+}
+string Money::toString() const {
+    char buffer[24];
+    char* end = buffer + sizeof(buffer);
+    char* pos = end;
+    unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+    *--pos = static_cast<char>('0' + magnitude % 10);
+    *--pos = static_cast<char>('0' + magnitude / 10 % 10);
+    *--pos = '.';
+    magnitude /= 100;
+    do {
+        *--pos = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        *--pos = '-';
+    }
+    return string(pos, end);
+}
+Money Money::operator+(Money other) const {
+    return fromCents(value + other.value);
+}
+Money Money::operator-(Money other) const {
+    return fromCents(value - other.value);
+}
+Money Money::operator-() const {
+    return fromCents(-value);
+}
+Money& Money::operator+=(Money other) {
+    value += other.value;
+    return *this;
+}
+Money& Money::operator-=(Money other) {
+    value -= other.value;
+    return *this;
+}
+bool Money::operator==(Money other) const {
+    return value == other.value;
+}
+bool Money::operator!=(Money other) const {
+    return value != other.value;
+}
+bool Money::operator<(Money other) const {
+    return value < other.value;
+}
+bool Money::operator<=(Money other) const {
+    return value <= other.value;
+}
+bool Money::operator>(Money other) const {
+    return value > other.value;
+}
+bool Money::operator>=(Money other) const {
+    return value >= other.value;
+}
+ostream& operator<<(ostream& out, Money amount) {
+    return out << amount.toString();
+}
+StringPool& StringPool::instance() {
+    static StringPool pool;
+    return pool;
+}
+StringPool::StringPool() : used(0) {
+    append("");
+}
+unsigned int StringPool::append(const string& value) {
+    size_t length = min(value.size(), static_cast<size_t>(0xFFFF));
+    size_t offset = used % CHUNK_SIZE;
+    if (offset + length + 2 > CHUNK_SIZE) {
+        used += CHUNK_SIZE - offset;
+        offset = 0;
+    }
+    size_t chunk = used / CHUNK_SIZE;
+    if (chunk >= MAX_CHUNKS) {
+        throw bad_alloc();
+    }
+    if (!chunks[chunk]) {
+        chunks[chunk].reset(new char[CHUNK_SIZE]);
+    }
+    char* data = chunks[chunk].get() + offset;
+    data[0] = static_cast<char>(length & 0xFF);
+    data[1] = static_cast<char>(length >> 8);
+    memcpy(data + 2, value.data(), length);
+    unsigned int handle = static_cast<unsigned int>(used);
+    used += length + 2;
+    return handle;
+}
+unsigned int StringPool::add(const string& value) {
+    lock_guard<mutex> guard(lock);
+    return append(value);
+}
+unsigned int StringPool::intern(const string& value) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (char c : value) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    lock_guard<mutex> guard(lock);
+    auto it = interned.find(hash);
+    if (it != interned.end() && get(it->second) == value) {
+        return it->second;
+    }
+    unsigned int handle = append(value);
+    if (it == interned.end()) {
+        interned[hash] = handle;
+    }
+    return handle;
+}
+string_view StringPool::get(unsigned int handle) const {
+    const char* data = chunks[handle / CHUNK_SIZE].get() + handle % CHUNK_SIZE;
+    size_t length = static_cast<unsigned char>(data[0]) | (static_cast<unsigned char>(data[1]) << 8);
+    return string_view(data + 2, length);
+}
+size_t StringPool::bytesUsed() const {
+    return used;
+}
+atomic<unsigned int> User::lastAccountId(1000);
+User::User()
+    : accountId(0), username(0), password(0), name(0), cardNumber(0), balance(),
+      accountType(AccountType::Savings), hasCard(false) {
+    memset(cardPin, 0, sizeof(cardPin));
 }
-User::User(string username, string password, string name, string accountType) 
-    : username(username), password(password), name(name), accountType(accountType), 
-      balance(0.0), hasCard(false) {
-    accountNumber = generateAccountNumber();
+User::User(string username, string password, string name, string accountType) : User() {
+    StringPool& pool = StringPool::instance();
+    this->username = pool.add(username);
+    this->password = pool.add(password);
+    this->name = pool.intern(name);
+    this->accountType = parseAccountType(accountType);
+    accountId = generateAccountNumber();
 }
 string User::getAccountNumber() const {
-    return accountNumber;
+    char digits[11] = "ACC0000000";
+    unsigned int id = accountId;
+    for (int i = 9; i >= 3 && id > 0; --i, id /= 10) {
+        digits[i] = static_cast<char>('0' + id % 10);
+    }
+    string number(digits, 10);
+    if (id > 0) {
+        number.insert(3, to_string(id));
+    }
+    return number;
 }
-string User::getUsername() const {
-    return username;
+string_view User::getUsername() const {
+    return StringPool::instance().get(username);
 }
-string User::getName() const {
-    return name;
+string_view User::getName() const {
+    return StringPool::instance().get(name);
 }
 string User::getAccountType() const {
+    return accountTypeName(accountType);
+}
+AccountType User::getAccountTypeCode() const {
     return accountType;
 }
 string User::getCardNumber() const {
-    return cardNumber;
+    if (cardNumber == 0) {
+        return "";
+    }
+    char digits[20];
+    unsigned long long number = cardNumber;
+    int pos = 18;
+    for (int i = 0; i < 16; ++i) {
+        if (i > 0 && i % 4 == 0) {
+            digits[pos--] = ' ';
+        }
+        digits[pos--] = static_cast<char>('0' + number % 10);
+        number /= 10;
+    }
+    return string(digits, 19);
 }
-double User::getBalance() const {
+Money User::getBalance() const {
     return balance;
 }
 bool User::getHasCard() const {
     return hasCard;
 }
-bool User::checkPassword(string password) const {
-    return this->password == password;
+bool User::checkPassword(const string& password) const {
+    return StringPool::instance().get(this->password) == password;
+}
+bool User::checkCardPin(const string& pin) const {
+    return hasCard && pin.size() == 4 && memcmp(cardPin, pin.data(), 4) == 0;
 }
-bool User::checkCardPin(string pin) const {
-    return hasCard && this->cardPin == pin;
+bool User::matchesCard(const string& cardNumber) const {
+    return hasCard && this->cardNumber == parseCardNumber(cardNumber);
 }
-void User::deposit(double amount) {
-    if (amount > 0) {
+unsigned long long User::getCardDigits() const {
+    return cardNumber;
+}
+void User::deposit(Money amount) {
+    if (amount > Money()) {
         balance += amount;
     }
 }
-bool User::withdraw(double amount) {
-    if (amount > 0 && balance >= amount) {
+bool User::withdraw(Money amount) {
+    if (amount > Money() && balance >= amount) {
         balance -= amount;
         return true;
     }
     return false;
 }
-void User::requestATMCard() {
-    if (!hasCard) {
-        cardNumber = generateCardNumber();
-        cardPin = generateCardPin();
-        hasCard = true;
-        cout << "\nATM Card issued successfully!\n";
-        cout << "Card Number: " << cardNumber << "\n";
-        cout << "PIN: " << cardPin << " (Keep this safe!)\n";
-    } else {
-        cout << "\nYou already have an ATM card.\n";
+string User::issueCard() {
+    if (hasCard) {
+        return "";
     }
+    cardNumber = generateCardNumber();
+    generateCardPin();
+    hasCard = true;
+    return string(cardPin, 4);
 }
 void User::changeCardPin(string newPin) {
     if (hasCard) {
         if (newPin.length() == 4) {
-            cardPin = newPin;
+            memcpy(cardPin, newPin.data(), 4);
             cout << "\nPIN changed successfully!\n";
         } else {
             cout << "\nPIN must be 4 digits!\n";
@@ -172,95 +829,131 @@ void User::changeCardPin(string newPin) {
         cout << "\nNo ATM card found. Please request a card first.\n";
     }
 }
-string User::generateAccountNumber() {
-    static int counter = 1000;
-    stringstream ss;
-    ss << "ACC" << setw(7) << setfill('0') << ++counter;
-    return ss.str();
+AccountType User::parseAccountType(const string& accountType) {
+    if (accountType == "Current") {
+        return AccountType::Current;
+    }
+    if (accountType == "Fixed") {
+        return AccountType::Fixed;
+    }
+    return AccountType::Savings;
+}
+const char* User::accountTypeName(AccountType accountType) {
+    switch (accountType) {
+        case AccountType::Current:
+            return "Current";
+        case AccountType::Fixed:
+            return "Fixed";
+        default:
+            return "Savings";
+    }
+}
+unsigned int User::parseAccountNumber(const string& accountNumber) {
+    unsigned int id = 0;
+    for (size_t i = 3; i < accountNumber.size(); ++i) {
+        if (isdigit(static_cast<unsigned char>(accountNumber[i]))) {
+            id = id * 10 + (accountNumber[i] - '0');
+        }
+    }
+    return id;
 }
-string User::generateCardNumber() {
+unsigned long long User::parseCardNumber(const string& cardNumber) {
+    unsigned long long number = 0;
+    for (char c : cardNumber) {
+        if (isdigit(static_cast<unsigned char>(c))) {
+            number = number * 10 + (c - '0');
+        }
+    }
+    return number;
+}
+void User::observeAccountId(unsigned int accountId) {
+    unsigned int last = lastAccountId.load();
+    while (accountId > last && !lastAccountId.compare_exchange_weak(last, accountId)) {
+    }
+}
+unsigned int User::generateAccountNumber() {
+    return ++lastAccountId;
+}
+unsigned long long User::generateCardNumber() {
     random_device rd;
     mt19937 gen(rd());
     uniform_int_distribution<> dis(0, 9);
-    stringstream ss;
-    ss << "4"; 
+    unsigned long long number = 4;
     for (int i = 0; i < 15; i++) {
-        ss << dis(gen);
-        if ((i + 1) % 4 == 0 && i < 14) {
-            ss << " ";
-        }
+        number = number * 10 + dis(gen);
     }
-    return ss.str();
+    return number;
 }
-string User::generateCardPin() {
+void User::generateCardPin() {
     random_device rd;
     mt19937 gen(rd());
     uniform_int_distribution<> dis(0, 9);
-    stringstream ss;
     for (int i = 0; i < 4; i++) {
-        ss << dis(gen);
+        cardPin[i] = static_cast<char>('0' + dis(gen));
     }
-    return ss.str();
 }
 string User::toJson() const {
+    StringPool& pool = StringPool::instance();
     stringstream ss;
     ss << "{";
-    ss << "\"accountNumber\":\"" << accountNumber << "\",";
-    ss << "\"username\":\"" << username << "\",";
-    ss << "\"password\":\"" << password << "\",";
-    ss << "\"name\":\"" << name << "\",";
-    ss << "\"accountType\":\"" << accountType << "\",";
-    ss << "\"cardNumber\":\"" << cardNumber << "\",";
-    ss << "\"cardPin\":\"" << cardPin << "\",";
+    ss << "\"accountNumber\":\"" << getAccountNumber() << "\",";
+    ss << "\"username\":\"" << pool.get(username) << "\",";
+    ss << "\"password\":\"" << pool.get(password) << "\",";
+    ss << "\"name\":\"" << pool.get(name) << "\",";
+    ss << "\"accountType\":\"" << accountTypeName(accountType) << "\",";
+    ss << "\"cardNumber\":\"" << getCardNumber() << "\",";
+    ss << "\"cardPin\":\"" << (hasCard ? string(cardPin, 4) : "") << "\",";
     ss << "\"hasCard\":" << (hasCard ? "true" : "false") << ",";
     ss << "\"balance\":" << balance;
     ss << "}";
     return ss.str();
 }
-User User::fromJson(const string& jsonStr) {
-    User user;
+bool User::fromJson(const string& jsonStr, User& user) {
+    StringPool& pool = StringPool::instance();
     size_t pos;
     pos = jsonStr.find("\"accountNumber\":\"");
     if (pos != string::npos) {
         pos += 17;
         size_t end = jsonStr.find("\"", pos);
-        user.accountNumber = jsonStr.substr(pos, end - pos);
+        user.accountId = parseAccountNumber(jsonStr.substr(pos, end - pos));
+        observeAccountId(user.accountId);
     }
     pos = jsonStr.find("\"username\":\"");
     if (pos != string::npos) {
         pos += 12;
         size_t end = jsonStr.find("\"", pos);
-        user.username = jsonStr.substr(pos, end - pos);
+        user.username = pool.add(jsonStr.substr(pos, end - pos));
     }
     pos = jsonStr.find("\"password\":\"");
     if (pos != string::npos) {
         pos += 12;
         size_t end = jsonStr.find("\"", pos);
-        user.password = jsonStr.substr(pos, end - pos);
+        user.password = pool.add(jsonStr.substr(pos, end - pos));
     }
     pos = jsonStr.find("\"name\":\"");
     if (pos != string::npos) {
         pos += 8;
         size_t end = jsonStr.find("\"", pos);
-        user.name = jsonStr.substr(pos, end - pos);
+        user.name = pool.intern(jsonStr.substr(pos, end - pos));
     }
     pos = jsonStr.find("\"accountType\":\"");
     if (pos != string::npos) {
         pos += 15;
         size_t end = jsonStr.find("\"", pos);
-        user.accountType = jsonStr.substr(pos, end - pos);
+        user.accountType = parseAccountType(jsonStr.substr(pos, end - pos));
     }
     pos = jsonStr.find("\"cardNumber\":\"");
     if (pos != string::npos) {
         pos += 14;
         size_t end = jsonStr.find("\"", pos);
-        user.cardNumber = jsonStr.substr(pos, end - pos);
+        user.cardNumber = parseCardNumber(jsonStr.substr(pos, end - pos));
     }
     pos = jsonStr.find("\"cardPin\":\"");
     if (pos != string::npos) {
         pos += 11;
         size_t end = jsonStr.find("\"", pos);
-        user.cardPin = jsonStr.substr(pos, end - pos);
+        string pin = jsonStr.substr(pos, end - pos);
+        memcpy(user.cardPin, pin.data(), min(pin.size(), sizeof(user.cardPin)));
     }
     pos = jsonStr.find("\"hasCard\":");
     if (pos != string::npos) {
@@ -270,13 +963,12 @@ User User::fromJson(const string& jsonStr) {
         user.hasCard = (hasCardStr == "true");
     }
     pos = jsonStr.find("\"balance\":");
-    if (pos != string::npos) {
-        pos += 10;
-        size_t end = jsonStr.find("}", pos);
-        string balanceStr = jsonStr.substr(pos, end - pos);
-        user.balance = stod(balanceStr);
+    if (pos == string::npos) {
+        return false;
     }
-    return user;
+    pos += 10;
+    size_t end = jsonStr.find("}", pos);
+    return Money::parse(jsonStr.substr(pos, end - pos), user.balance);
 }
 string Transaction::toJson() const {
     stringstream ss;
@@ -286,15 +978,29 @@ string Transaction::toJson() const {
     ss << "\"type\":\"" << type << "\",";
     ss << "\"amount\":" << amount << ",";
     ss << "\"balance\":" << balance;
+    if (!hash.empty()) {
+        ss << ",\"hash\":\"" << hash << "\"";
+    }
     ss << "}";
     return ss.str();
 }
-Transaction Transaction::fromJson(const string& jsonStr) {
-    Transaction trans;
+string Transaction::kind() const {
+    return type.substr(0, type.find(':'));
+}
+string Transaction::canonical() const {
+    stringstream ss;
+    ss << timestamp << '|' << accountNumber << '|' << type << '|'
+       << amount.cents() << '|' << balance.cents();
+    return ss.str();
+}
+string Transaction::chainHash(const string& previous) const {
+    return Sha256::hash(previous + "|" + canonical());
+}
+bool Transaction::fromJson(const string& jsonStr, Transaction& trans) {
     size_t pos;
     pos = jsonStr.find("\"timestamp\":\"");
     if (pos != string::npos) {
-        pos += 14;
+        pos += 13;
         size_t end = jsonStr.find("\"", pos);
         trans.timestamp = jsonStr.substr(pos, end - pos);
     }
@@ -310,53 +1016,403 @@ Transaction Transaction::fromJson(const string& jsonStr) {
         size_t end = jsonStr.find("\"", pos);
         trans.type = jsonStr.substr(pos, end - pos);
     }
+    bool valid = false;
     pos = jsonStr.find("\"amount\":");
     if (pos != string::npos) {
         pos += 9;
         size_t end = jsonStr.find(",", pos);
-        string amountStr = jsonStr.substr(pos, end - pos);
-        trans.amount = stod(amountStr);
+        valid = Money::parse(jsonStr.substr(pos, end - pos), trans.amount);
     }
     pos = jsonStr.find("\"balance\":");
-    if (pos != string::npos) {
+    if (pos == string::npos) {
+        valid = false;
+    } else {
         pos += 10;
-        size_t end = jsonStr.find("}", pos);
-        string balanceStr = jsonStr.substr(pos, end - pos);
-        trans.balance = stod(balanceStr);
+        size_t end = jsonStr.find_first_of(",}", pos);
+        valid = Money::parse(jsonStr.substr(pos, end - pos), trans.balance) && valid;
+    }
+    pos = jsonStr.find("\"hash\":\"");
+    if (pos != string::npos) {
+        pos += 8;
+        size_t end = jsonStr.find("\"", pos);
+        trans.hash = jsonStr.substr(pos, end - pos);
+    }
+    return valid;
+}
+const unsigned int Sha256::ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+Sha256::Sha256() : bufferLength(0), totalLength(0) {
+    const unsigned int initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(state, initial, sizeof(state));
+}
+void Sha256::transform(const unsigned char* block) {
+    auto rotate = [](unsigned int value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    };
+    unsigned int w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (static_cast<unsigned int>(block[i * 4]) << 24) | (static_cast<unsigned int>(block[i * 4 + 1]) << 16) |
+               (static_cast<unsigned int>(block[i * 4 + 2]) << 8) | static_cast<unsigned int>(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        unsigned int s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        unsigned int s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+    unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        unsigned int t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + ROUND_CONSTANTS[i] + w[i];
+        unsigned int t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+void Sha256::update(const char* data, size_t length) {
+    totalLength += length;
+    while (length > 0) {
+        size_t take = min(length, sizeof(buffer) - bufferLength);
+        memcpy(buffer + bufferLength, data, take);
+        bufferLength += take;
+        data += take;
+        length -= take;
+        if (bufferLength == sizeof(buffer)) {
+            transform(buffer);
+            bufferLength = 0;
+        }
+    }
+}
+void Sha256::update(const string& data) {
+    update(data.data(), data.size());
+}
+string Sha256::digest() {
+    unsigned long long bits = totalLength * 8;
+    char padding[72] = {static_cast<char>(0x80)};
+    size_t padLength = bufferLength < 56 ? 56 - bufferLength : 120 - bufferLength;
+    for (int i = 0; i < 8; ++i) {
+        padding[padLength + i] = static_cast<char>(bits >> (56 - 8 * i));
+    }
+    update(padding, padLength + 8);
+    string result(32, '\0');
+    for (int i = 0; i < 32; ++i) {
+        result[i] = static_cast<char>(state[i / 4] >> (24 - 8 * (i % 4)));
     }
-    return trans;
+    return result;
+}
+string Sha256::toHex(const string& bytes) {
+    static const char digits[] = "0123456789abcdef";
+    string hex;
+    hex.reserve(bytes.size() * 2);
+    for (unsigned char byte : bytes) {
+        hex.push_back(digits[byte >> 4]);
+        hex.push_back(digits[byte & 0x0F]);
+    }
+    return hex;
+}
+string Sha256::hash(const string& data) {
+    Sha256 sha;
+    sha.update(data);
+    return toHex(sha.digest());
+}
+string Sha256::hmac(const string& key, const string& message) {
+    string block = key;
+    if (block.size() > 64) {
+        Sha256 sha;
+        sha.update(block);
+        block = sha.digest();
+    }
+    block.resize(64, '\0');
+    string inner = block, outer = block;
+    for (size_t i = 0; i < 64; ++i) {
+        inner[i] ^= 0x36;
+        outer[i] ^= 0x5c;
+    }
+    Sha256 innerSha;
+    innerSha.update(inner);
+    innerSha.update(message);
+    Sha256 outerSha;
+    outerSha.update(outer);
+    outerSha.update(innerSha.digest());
+    return toHex(outerSha.digest());
 }
 string FileHandler::getCurrentTimestamp() {
-    time_t now = time(nullptr);
-    tm* local = localtime(&now);
+    return formatTimestamp(time(nullptr));
+}
+string FileHandler::formatTimestamp(time_t when) {
+    tm local;
+#ifdef _WIN32
+    localtime_s(&local, &when);
+#else
+    localtime_r(&when, &local);
+#endif
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    return buffer;
+}
+int FileHandler::getShardCount() {
+    if (shardCount == 0) {
+        shardCount = 1;
+        ifstream file(dataPath(SHARDS_CONFIG_FILE));
+        int configured;
+        if (file >> configured && configured > 0) {
+            shardCount = configured;
+        }
+    }
+    return shardCount;
+}
+int FileHandler::shardOf(const string& accountNumber) {
+    unsigned int hash = 2166136261u;
+    for (char c : accountNumber) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return static_cast<int>(hash % getShardCount());
+}
+void FileHandler::setDataDirectory(const string& directory) {
+    dataDirectory = directory;
+    shardCount = 0;
+    lock_guard<mutex> guard(ledgerSizesLock);
+    ledgerSizes.clear();
+}
+mutex& FileHandler::shardLock(int shard) {
+    return shardLocks[shard % SHARD_LOCKS];
+}
+void FileHandler::setLedgerSize(int shard, size_t size) {
+    size_t archived = LedgerArchive::recordCount(shardFile(ARCHIVE_FILE, shard, getShardCount()));
+    lock_guard<mutex> guard(ledgerSizesLock);
+    ledgerSizes.resize(getShardCount(), 0);
+    ledgerSizes[shard] = archived + size;
+}
+vector<size_t> FileHandler::getLedgerSizes() {
+    {
+        lock_guard<mutex> guard(ledgerSizesLock);
+        if (ledgerSizes.size() == static_cast<size_t>(getShardCount())) {
+            return ledgerSizes;
+        }
+    }
+    loadAllTransactions();
+    lock_guard<mutex> guard(ledgerSizesLock);
+    return ledgerSizes;
+}
+vector<Transaction> FileHandler::loadLedgerShard(int shard) {
+    bool intact;
+    return loadLedgerShard(shard, intact);
+}
+vector<Transaction> FileHandler::loadLedgerShard(int shard, bool& intact) {
+    int count = getShardCount();
+    lock_guard<mutex> guard(shardLock(shard));
+    vector<Transaction> transactions;
+    intact = LedgerArchive::scan(shardFile(ARCHIVE_FILE, shard, count), "", [&transactions](const Transaction& trans) {
+        transactions.push_back(trans);
+    });
+    bool hotIntact;
+    auto hot = loadTransactionsFrom(shardFile(TRANSACTIONS_FILE, shard, count), hotIntact);
+    intact = intact && hotIntact;
+    transactions.insert(transactions.end(), hot.begin(), hot.end());
+    return transactions;
+}
+bool FileHandler::readLedgerShard(int shard, size_t limit, const function<void(const Transaction&)>& visit) {
+    int count = getShardCount();
+    string archivePath = shardFile(ARCHIVE_FILE, shard, count);
+    string path = shardFile(TRANSACTIONS_FILE, shard, count);
+    size_t archived;
+    string hot;
+    {
+        lock_guard<mutex> guard(shardLock(shard));
+        archived = LedgerArchive::recordCount(archivePath);
+        ifstream file(path, ios::binary);
+        hot.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    // Archives only grow by appending, so their first archived records match the hot rows captured with them.
+    size_t seen = 0;
+    bool intact = true;
+    if (archived > 0 && limit > 0) {
+        intact = LedgerArchive::scan(archivePath, "", [&](const Transaction& trans) {
+            if (seen < archived && seen < limit) {
+                visit(trans);
+            }
+            seen++;
+        });
+        seen = min(seen, archived);
+    }
+    if (seen < limit) {
+        stringstream rows(hot);
+        intact = readTransactions(rows, path, limit - seen, visit) && intact;
+    }
+    return intact;
+}
+void FileHandler::scanArchives(const function<void(const Transaction&)>& visit) {
+    int count = getShardCount();
+    for (int i = 0; i < count; ++i) {
+        lock_guard<mutex> guard(shardLock(i));
+        LedgerArchive::scan(shardFile(ARCHIVE_FILE, i, count), "", visit);
+    }
+}
+ArchiveStats FileHandler::archiveTransactions(time_t cutoff) {
+    int count = getShardCount();
+    vector<ArchiveStats> shards(count, ArchiveStats{0, 0, 0});
+    vector<thread> workers;
+    for (int i = 0; i < count; ++i) {
+        workers.emplace_back([&shards, i, count, cutoff]() {
+            lock_guard<mutex> guard(shardLock(i));
+            string path = shardFile(TRANSACTIONS_FILE, i, count);
+            string archivePath = shardFile(ARCHIVE_FILE, i, count);
+            bool intact;
+            auto transactions = loadTransactionsFrom(path, intact);
+            if (!intact) {
+                cerr << "Error: Shard " << i << " not archived; repair " << path << " first.\n";
+                return;
+            }
+            LedgerCheckpoint head;
+            bool keyed = !signingKey().empty();
+            if ((keyed || hasSeals(i, count)) && !sealLedger(i, transactions, 0, false, head)) {
+                cerr << "Error: Shard " << i << " not archived; "
+                     << (keyed ? "run --seal-ledger to seal its older records first.\n"
+                               : "its ledger is sealed, so set " + LEDGER_KEY_ENV + " to the ledger key first.\n");
+                return;
+            }
+            size_t archivedBefore = LedgerArchive::recordCount(archivePath);
+            size_t split = 0;
+            while (split < transactions.size()) {
+                time_t when = parseTimestamp(transactions[split].timestamp);
+                if (when >= cutoff) {
+                    break;
+                }
+                shards[i].jsonBytes += transactions[split].toJson().size() + 2;
+                split++;
+            }
+            if (split == 0) {
+                return;
+            }
+            vector<Transaction> archived(transactions.begin(), transactions.begin() + split);
+            string archiveTemp = archivePath + TEMP_SUFFIX;
+            string hotTemp = path + TEMP_SUFFIX;
+            error_code error;
+            streamoff previousBytes = 0;
+            if (filesystem::exists(archivePath)) {
+                previousBytes = static_cast<streamoff>(filesystem::file_size(archivePath, error));
+                filesystem::copy_file(archivePath, archiveTemp, filesystem::copy_options::overwrite_existing, error);
+            } else {
+                filesystem::remove(archiveTemp, error);
+            }
+            if ((archivedBefore + split) % CHECKPOINT_INTERVAL != 0) {
+                appendCheckpoint(i, archivedBefore + split, transactions[split - 1].hash);
+            }
+            transactions.erase(transactions.begin(), transactions.begin() + split);
+            if (error || !LedgerArchive::append(archiveTemp, archived) || !saveTransactionsTo(hotTemp, transactions)) {
+                cerr << "Error: Could not stage archive for shard " << i << ".\n";
+                filesystem::remove(archiveTemp, error);
+                filesystem::remove(hotTemp, error);
+                return;
+            }
+            // Renaming the archive commits the move; recoverArchives finishes the hot file after a crash.
+            filesystem::rename(archiveTemp, archivePath, error);
+            if (error) {
+                cerr << "Error: Could not replace archive for shard " << i << ".\n";
+                filesystem::remove(archiveTemp, error);
+                filesystem::remove(hotTemp, error);
+                return;
+            }
+            filesystem::rename(hotTemp, path, error);
+            if (error) {
+                cerr << "Error: Could not replace transactions for shard " << i << "; it will be recovered on restart.\n";
+            }
+            shards[i].archiveBytes = static_cast<size_t>(static_cast<streamoff>(filesystem::file_size(archivePath, error)) - previousBytes);
+            shards[i].records = split;
+            setLedgerSize(i, transactions.size());
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    ArchiveStats total = {0, 0, 0};
+    for (const auto& shard : shards) {
+        total.records += shard.records;
+        total.jsonBytes += shard.jsonBytes;
+        total.archiveBytes += shard.archiveBytes;
+    }
+    return total;
+}
+string FileHandler::dataPath(const string& file) {
+    return dataDirectory + "/" + file;
+}
+string FileHandler::shardFile(const string& file, int shard, int count) {
+    if (count == 1) {
+        return dataPath(file);
+    }
+    size_t dot = file.rfind('.');
     stringstream ss;
-    ss << put_time(local, "%Y-%m-%d %H:%M:%S");
+    ss << dataDirectory << "/" << file.substr(0, dot) << "." << shard << "-of-" << count << file.substr(dot);
     return ss.str();
 }
-vector<Transaction> FileHandler::loadAllTransactions() {
+vector<Transaction> FileHandler::loadTransactionsFrom(const string& path) {
+    bool intact;
+    return loadTransactionsFrom(path, intact);
+}
+vector<Transaction> FileHandler::loadTransactionsFrom(const string& path, bool& intact) {
     vector<Transaction> transactions;
-    ifstream file(TRANSACTIONS_FILE);
+    intact = true;
+    ifstream file(path);
     if (!file.is_open()) {
         return transactions;
     }
+    intact = readTransactions(file, path, numeric_limits<size_t>::max(), [&transactions](const Transaction& trans) {
+        transactions.push_back(trans);
+    });
+    file.close();
+    return transactions;
+}
+bool FileHandler::readTransactions(istream& in, const string& path, size_t limit, const function<void(const Transaction&)>& visit) {
+    bool intact = true;
+    size_t visited = 0;
     string line;
-    while (getline(file, line)) {
+    for (size_t lineNumber = 1; visited < limit && getline(in, line); ++lineNumber) {
         if (line.empty() || line == "[" || line == "]") {
             continue;
         }
         if (line.back() == ',') {
             line.pop_back();
         }
-        transactions.push_back(Transaction::fromJson(line));
+        Transaction trans;
+        if (!Transaction::fromJson(line, trans)) {
+            cerr << "Error: " << path << " line " << lineNumber << ": malformed amount or balance, record rejected.\n";
+            intact = false;
+            continue;
+        }
+        visit(trans);
+        visited++;
     }
-    file.close();
-    return transactions;
+    return intact;
 }
-void FileHandler::saveAllTransactions(const vector<Transaction>& transactions) {
-    ofstream file(TRANSACTIONS_FILE);
+bool FileHandler::saveTransactionsTo(const string& path, const vector<Transaction>& transactions) {
+    ofstream file(path);
     if (!file.is_open()) {
         cerr << "Error: Could not open transactions file.\n";
-        return;
+        return false;
     }
     file << "[\n";
     for (size_t i = 0; i < transactions.size(); ++i) {
@@ -364,83 +1420,1769 @@ void FileHandler::saveAllTransactions(const vector<Transaction>& transactions) {
         if (i != transactions.size() - 1) {
             file << ",";
         }
-        file << "\n";
+        file << "\n";
+    }
+    file << "]\n";
+    file.close();
+    return !file.fail();
+}
+vector<Transaction> FileHandler::loadAllTransactions() {
+    int count = getShardCount();
+    vector<vector<Transaction>> shards(count);
+    vector<thread> loaders;
+    for (int i = 0; i < count; ++i) {
+        loaders.emplace_back([&shards, i, count]() {
+            lock_guard<mutex> guard(shardLock(i));
+            shards[i] = loadTransactionsFrom(shardFile(TRANSACTIONS_FILE, i, count));
+            setLedgerSize(i, shards[i].size());
+        });
+    }
+    for (auto& loader : loaders) {
+        loader.join();
+    }
+    vector<Transaction> transactions;
+    for (auto& shard : shards) {
+        transactions.insert(transactions.end(), shard.begin(), shard.end());
+    }
+    return transactions;
+}
+void FileHandler::saveUser(const User& user) {
+    int shard = shardOf(user.getAccountNumber());
+    string path = shardFile(USERS_FILE, shard, getShardCount());
+    lock_guard<mutex> guard(shardLock(shard));
+    mergeUserRows(path, {user});
+}
+vector<string> FileHandler::loadUserRows(const string& path) {
+    vector<string> rows;
+    ifstream file(path);
+    if (!file.is_open()) {
+        return rows;
+    }
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line == "[" || line == "]") {
+            continue;
+        }
+        if (line.back() == ',') {
+            line.pop_back();
+        }
+        rows.push_back(line);
+    }
+    file.close();
+    return rows;
+}
+bool FileHandler::saveUserRows(const string& path, const vector<string>& rows) {
+    ofstream file(path);
+    if (!file.is_open()) {
+        cerr << "Error: Could not open users file.\n";
+        return false;
+    }
+    file << "[\n";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        file << rows[i];
+        if (i != rows.size() - 1) {
+            file << ",";
+        }
+        file << "\n";
+    }
+    file << "]\n";
+    file.close();
+    return !file.fail();
+}
+bool FileHandler::mergeUserRows(const string& path, const vector<User>& users) {
+    return mergeUserRows(path, path, users);
+}
+bool FileHandler::mergeUserRows(const string& path, const string& target, const vector<User>& users) {
+    auto rows = loadUserRows(path);
+    unordered_map<string, size_t> positions;
+    for (size_t j = 0; j < rows.size(); ++j) {
+        size_t pos = rows[j].find("\"accountNumber\":\"");
+        if (pos != string::npos) {
+            pos += 17;
+            positions[rows[j].substr(pos, rows[j].find('"', pos) - pos)] = j;
+        }
+    }
+    for (const auto& user : users) {
+        auto it = positions.find(user.getAccountNumber());
+        if (it != positions.end()) {
+            rows[it->second] = user.toJson();
+        } else {
+            positions[user.getAccountNumber()] = rows.size();
+            rows.push_back(user.toJson());
+        }
+    }
+    return saveUserRows(target, rows);
+}
+vector<User> FileHandler::loadUsersFrom(const string& path, bool& intact) {
+    vector<User> users;
+    intact = true;
+    vector<string> rows = loadUserRows(path);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        User user;
+        if (!User::fromJson(rows[i], user)) {
+            cerr << "Error: " << path << " account " << i + 1 << ": malformed balance, record rejected.\n";
+            intact = false;
+            continue;
+        }
+        users.push_back(user);
+    }
+    return users;
+}
+void FileHandler::saveAllUsers(const vector<User>& users) {
+    int count = getShardCount();
+    vector<vector<User>> shards(count);
+    for (const auto& user : users) {
+        shards[shardOf(user.getAccountNumber())].push_back(user);
+    }
+    vector<thread> writers;
+    for (int i = 0; i < count; ++i) {
+        writers.emplace_back([&shards, i, count]() {
+            lock_guard<mutex> guard(shardLock(i));
+            mergeUserRows(shardFile(USERS_FILE, i, count), shards[i]);
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+}
+vector<User> FileHandler::loadAllUsers() {
+    bool intact;
+    return loadAllUsers(intact);
+}
+vector<User> FileHandler::loadAllUsers(bool& intact) {
+    int count = getShardCount();
+    vector<vector<User>> shards(count);
+    vector<char> shardIntact(count, 1);
+    vector<thread> loaders;
+    for (int i = 0; i < count; ++i) {
+        loaders.emplace_back([&shards, &shardIntact, i, count]() {
+            lock_guard<mutex> guard(shardLock(i));
+            bool rowsIntact;
+            shards[i] = loadUsersFrom(shardFile(USERS_FILE, i, count), rowsIntact);
+            shardIntact[i] = rowsIntact;
+        });
+    }
+    for (auto& loader : loaders) {
+        loader.join();
+    }
+    intact = find(shardIntact.begin(), shardIntact.end(), 0) == shardIntact.end();
+    vector<User> users;
+    for (auto& shard : shards) {
+        users.insert(users.end(), shard.begin(), shard.end());
+    }
+    sort(users.begin(), users.end(), [](const User& a, const User& b) {
+        return a.getAccountNumber() < b.getAccountNumber();
+    });
+    return users;
+}
+time_t FileHandler::parseTimestamp(const string& timestamp) {
+    tm parsed = {};
+    if (sscanf(timestamp.c_str(), "%d-%d-%d %d:%d:%d", &parsed.tm_year, &parsed.tm_mon, &parsed.tm_mday,
+               &parsed.tm_hour, &parsed.tm_min, &parsed.tm_sec) != 6 || parsed.tm_year < 1970) {
+        return -1;
+    }
+    parsed.tm_year -= 1900;
+    parsed.tm_mon -= 1;
+    parsed.tm_isdst = -1;
+    return mktime(&parsed);
+}
+bool FileHandler::loadTransferBatch(const string& path, vector<TransferRequest>& requests, vector<string>& errors) {
+    ifstream file(path);
+    if (!file.is_open()) {
+        errors.push_back("Could not open batch file " + path + ".");
+        return false;
+    }
+    string line;
+    size_t lineNumber = 0;
+    while (getline(file, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        stringstream ss(line);
+        TransferRequest request = {"", "", Money()};
+        string amount, extra;
+        getline(ss, request.fromAccount, ',');
+        getline(ss, request.toAccount, ',');
+        bool complete = static_cast<bool>(getline(ss, amount, ',')) && !getline(ss, extra, ',');
+        stringstream error;
+        if (!complete || request.fromAccount.empty() || request.toAccount.empty()) {
+            error << "Line " << lineNumber << ": expected fromAccount,toAccount,amount.";
+        } else if (!Money::parse(amount, request.amount)) {
+            error << "Line " << lineNumber << ": malformed amount '" << amount << "'.";
+        } else {
+            requests.push_back(request);
+            continue;
+        }
+        errors.push_back(error.str());
+    }
+    file.close();
+    return errors.empty();
+}
+Transaction FileHandler::makeTransaction(const User& user, const string& type, Money amount) {
+    return {getCurrentTimestamp(), user.getAccountNumber(), type, amount, user.getBalance(), ""};
+}
+LedgerPosition FileHandler::saveTransaction(const Transaction& trans) {
+    int shard = shardOf(trans.accountNumber);
+    string path = shardFile(TRANSACTIONS_FILE, shard, getShardCount());
+    lock_guard<mutex> guard(shardLock(shard));
+    bool intact;
+    auto transactions = loadTransactionsFrom(path, intact);
+    if (!intact) {
+        cerr << "Error: Transaction not recorded; repair " << path << " first.\n";
+        return {-1, 0};
+    }
+    transactions.push_back(trans);
+    transactions.back().hash.clear();
+    LedgerCheckpoint head;
+    bool sealed = sealLedger(shard, transactions, 1, false, head);
+    if (!saveTransactionsTo(path, transactions)) {
+        cerr << "Error: Transaction not recorded; could not write " << path << ".\n";
+        return {-1, 0};
+    }
+    if (sealed) {
+        writeHead(shard, head);
+    }
+    setLedgerSize(shard, transactions.size());
+    size_t archived = LedgerArchive::recordCount(shardFile(ARCHIVE_FILE, shard, getShardCount()));
+    return {shard, archived + transactions.size() - 1};
+}
+void FileHandler::saveAggregates(const AggregateSummary& summary) {
+    ofstream file(dataPath(AGGREGATES_FILE));
+    if (!file.is_open()) {
+        cerr << "Error: Could not open aggregates file.\n";
+        return;
+    }
+    file << "[\n";
+    file << "{\"ledgerRecords\":" << summary.ledgerRecords << ",\"accounts\":" << summary.accounts
+         << ",\"totalBalance\":" << summary.totalBalance << ",\"version\":" << AGGREGATES_VERSION
+         << ",\"fingerprint\":\"" << dataFingerprint() << "\"},\n";
+    for (const auto& entry : summary.typeBalances) {
+        file << "{\"accountType\":\"" << entry.first << "\",\"accounts\":" << summary.typeAccounts.at(entry.first)
+             << ",\"balance\":" << entry.second << "},\n";
+    }
+    for (const auto& entry : summary.topAccounts) {
+        file << "{\"topAccount\":\"" << entry.first << "\",\"balance\":" << entry.second << "},\n";
+    }
+    for (const auto& day : summary.daily) {
+        for (const auto& kind : day.second) {
+            file << "{\"day\":\"" << day.first << "\",\"type\":\"" << kind.first << "\",\"count\":"
+                 << kind.second.count << ",\"amount\":" << kind.second.amount << "},\n";
+        }
+    }
+    file << "{}\n";
+    file << "]\n";
+    file.close();
+}
+bool FileHandler::loadAggregates(AggregateSummary& summary) {
+    ifstream file(dataPath(AGGREGATES_FILE));
+    if (!file.is_open()) {
+        return false;
+    }
+    auto text = [](const string& line, const string& key) {
+        size_t pos = line.find("\"" + key + "\":\"") + key.size() + 4;
+        return line.substr(pos, line.find('"', pos) - pos);
+    };
+    auto field = [](const string& line, const string& key) {
+        size_t pos = line.find("\"" + key + "\":") + key.size() + 3;
+        return line.substr(pos, line.find_first_of(",}", pos) - pos);
+    };
+    auto number = [&field](const string& line, const string& key) {
+        return strtoull(field(line, key).c_str(), nullptr, 10);
+    };
+    auto money = [&field](const string& line, const string& key) {
+        Money amount;
+        Money::parse(field(line, key), amount);
+        return amount;
+    };
+    summary = AggregateSummary();
+    bool found = false;
+    string line;
+    while (getline(file, line)) {
+        if (line.find("\"ledgerRecords\":") != string::npos) {
+            summary.ledgerRecords = static_cast<size_t>(number(line, "ledgerRecords"));
+            summary.accounts = static_cast<size_t>(number(line, "accounts"));
+            summary.totalBalance = money(line, "totalBalance");
+            found = line.find("\"version\":") != string::npos && number(line, "version") == AGGREGATES_VERSION;
+            summary.fingerprint = found ? text(line, "fingerprint") : "";
+        } else if (line.find("\"accountType\":") != string::npos) {
+            string type = text(line, "accountType");
+            summary.typeAccounts[type] = static_cast<size_t>(number(line, "accounts"));
+            summary.typeBalances[type] = money(line, "balance");
+        } else if (line.find("\"topAccount\":") != string::npos) {
+            summary.topAccounts.push_back(make_pair(text(line, "topAccount"), money(line, "balance")));
+        } else if (line.find("\"day\":") != string::npos) {
+            VolumeBucket& bucket = summary.daily[text(line, "day")][text(line, "type")];
+            bucket.count = static_cast<long>(number(line, "count"));
+            bucket.amount = money(line, "amount");
+        }
+    }
+    file.close();
+    return found;
+}
+string FileHandler::dataFingerprint() {
+    int count = getShardCount();
+    stringstream ss;
+    ss << count;
+    for (int i = 0; i < count; ++i) {
+        for (const string& file : {USERS_FILE, TRANSACTIONS_FILE, ARCHIVE_FILE}) {
+            string path = shardFile(file, i, count);
+            error_code error;
+            uintmax_t size = filesystem::file_size(path, error);
+            if (error) {
+                ss << "|-";
+                continue;
+            }
+            ss << "|" << size << ":" << filesystem::last_write_time(path, error).time_since_epoch().count();
+        }
+    }
+    return Sha256::hash(ss.str());
+}
+bool FileHandler::aggregatesCurrent(const AggregateSummary& summary) {
+    return !filesystem::exists(dataPath(JOURNAL_FILE)) && summary.fingerprint == dataFingerprint();
+}
+bool FileHandler::isDataPath(const string& path) {
+    error_code error;
+    filesystem::path data = filesystem::weakly_canonical(dataDirectory, error);
+    filesystem::path target = filesystem::weakly_canonical(path, error);
+    return mismatch(data.begin(), data.end(), target.begin(), target.end()).first == data.end();
+}
+string FileHandler::ledgerKey() {
+    static string cachedPath, cachedKey;
+    lock_guard<mutex> guard(keyLock);
+    const char* path = getenv(LEDGER_KEY_ENV.c_str());
+    if (!path || !*path || isDataPath(path)) {
+        return "";
+    }
+    if (!cachedKey.empty() && cachedPath == path) {
+        return cachedKey;
+    }
+    ifstream file(path);
+    string key;
+    if (!file.is_open() || !getline(file, key)) {
+        return "";
+    }
+    if (!key.empty() && key.back() == '\r') {
+        key.pop_back();
+    }
+    if (key.size() != 64) {
+        return "";
+    }
+    cachedPath = path;
+    cachedKey = key;
+    return key;
+}
+string FileHandler::signingKey() {
+    static atomic<bool> warned(false);
+    string key = ledgerKey();
+    if (key.empty() && !warned.exchange(true)) {
+        cerr << "Warning: " << LEDGER_KEY_ENV << " does not name a ledger key outside the data directory; "
+             << "the ledger is not being sealed.\n";
+    }
+    return key;
+}
+bool FileHandler::generateLedgerKey(const string& path) {
+    if (isDataPath(path)) {
+        cerr << "Error: The ledger key must live outside the data directory.\n";
+        return false;
+    }
+    if (filesystem::exists(path)) {
+        cerr << "Error: " << path << " already exists.\n";
+        return false;
+    }
+    random_device device;
+    string bytes(32, '\0');
+    for (auto& byte : bytes) {
+        byte = static_cast<char>(device() & 0xFF);
+    }
+    ofstream out(path);
+    if (!out.is_open()) {
+        cerr << "Error: Could not open ledger key file.\n";
+        return false;
+    }
+    out << Sha256::toHex(bytes) << "\n";
+    out.close();
+    error_code error;
+    filesystem::permissions(path, filesystem::perms::owner_read | filesystem::perms::owner_write, error);
+    return !out.fail();
+}
+string FileHandler::signCheckpoint(const string& key, size_t sequence, const string& hash) {
+    return Sha256::hmac(key, to_string(sequence) + ":" + hash);
+}
+string FileHandler::signHead(const string& key, size_t sequence, const string& hash) {
+    return Sha256::hmac(key, "head:" + to_string(sequence) + ":" + hash);
+}
+vector<LedgerCheckpoint> FileHandler::loadCheckpoints(int shard) {
+    return loadCheckpointsFrom(shardFile(CHECKPOINTS_FILE, shard, getShardCount()));
+}
+bool FileHandler::hasSeals(int shard, int count) {
+    return filesystem::exists(shardFile(HEAD_FILE, shard, count)) || filesystem::exists(shardFile(CHECKPOINTS_FILE, shard, count));
+}
+bool FileHandler::loadHead(int shard, LedgerCheckpoint& head) {
+    vector<LedgerCheckpoint> heads = loadCheckpointsFrom(shardFile(HEAD_FILE, shard, getShardCount()));
+    if (heads.empty()) {
+        return false;
+    }
+    head = heads.back();
+    return true;
+}
+vector<LedgerCheckpoint> FileHandler::loadCheckpointsFrom(const string& path) {
+    vector<LedgerCheckpoint> checkpoints;
+    ifstream file(path);
+    if (!file.is_open()) {
+        return checkpoints;
+    }
+    auto text = [](const string& line, const string& key) {
+        size_t pos = line.find("\"" + key + "\":\"");
+        if (pos == string::npos) {
+            return string();
+        }
+        pos += key.size() + 4;
+        return line.substr(pos, line.find('"', pos) - pos);
+    };
+    string line;
+    while (getline(file, line)) {
+        size_t pos = line.find("\"sequence\":");
+        if (pos == string::npos) {
+            continue;
+        }
+        LedgerCheckpoint checkpoint;
+        checkpoint.sequence = static_cast<size_t>(strtoull(line.c_str() + pos + 11, nullptr, 10));
+        checkpoint.hash = text(line, "hash");
+        checkpoint.signature = text(line, "signature");
+        checkpoints.push_back(checkpoint);
+    }
+    file.close();
+    return checkpoints;
+}
+void FileHandler::appendCheckpoint(int shard, size_t sequence, const string& hash) {
+    string key = signingKey();
+    if (key.empty()) {
+        return;
+    }
+    ofstream file(shardFile(CHECKPOINTS_FILE, shard, getShardCount()), ios::app);
+    if (!file.is_open()) {
+        cerr << "Error: Could not open checkpoint file.\n";
+        return;
+    }
+    file << "{\"sequence\":" << sequence << ",\"hash\":\"" << hash << "\",\"signature\":\""
+         << signCheckpoint(key, sequence, hash) << "\"}\n";
+    file.close();
+}
+void FileHandler::writeHead(int shard, const LedgerCheckpoint& head) {
+    string path = shardFile(HEAD_FILE, shard, getShardCount());
+    ofstream file(path + TEMP_SUFFIX);
+    if (!file.is_open()) {
+        cerr << "Error: Could not open ledger head file.\n";
+        return;
+    }
+    file << "{\"sequence\":" << head.sequence << ",\"hash\":\"" << head.hash << "\",\"signature\":\""
+         << head.signature << "\"}\n";
+    file.close();
+    error_code error;
+    filesystem::rename(path + TEMP_SUFFIX, path, error);
+    if (file.fail() || error) {
+        cerr << "Error: Could not write ledger head for shard " << shard << ".\n";
+    }
+}
+bool FileHandler::sealLedger(int shard, vector<Transaction>& transactions, size_t fresh, bool adopt, LedgerCheckpoint& head) {
+    string key = signingKey();
+    if (key.empty()) {
+        return false;
+    }
+    string archivePath = shardFile(ARCHIVE_FILE, shard, getShardCount());
+    size_t archived = LedgerArchive::recordCount(archivePath);
+    LedgerCheckpoint signedHead;
+    bool hasHead = loadHead(shard, signedHead);
+    if (hasHead && (signHead(key, signedHead.sequence, signedHead.hash) != signedHead.signature ||
+                    signedHead.sequence < archived || signedHead.sequence > archived + transactions.size())) {
+        cerr << "Error: Shard " << shard << " has an invalid ledger head" << (fresh > 0 ? "; new records were left unsealed" : "")
+             << ". Run --verify-ledger.\n";
+        return false;
+    }
+    size_t start = transactions.size() - fresh;
+    string previous = hasHead ? signedHead.hash : LEDGER_GENESIS;
+    if (adopt) {
+        start = hasHead ? signedHead.sequence - archived : 0;
+        if (!hasHead && archived > 0) {
+            bool found = false;
+            for (const auto& checkpoint : loadCheckpoints(shard)) {
+                if (checkpoint.sequence == archived && signCheckpoint(key, checkpoint.sequence, checkpoint.hash) == checkpoint.signature) {
+                    previous = checkpoint.hash;
+                    found = true;
+                }
+            }
+            if (!found) {
+                size_t scanned = 0;
+                if (!LedgerArchive::scan(archivePath, "", [&previous, &scanned, shard](const Transaction& trans) {
+                        previous = trans.chainHash(previous);
+                        if (++scanned % CHECKPOINT_INTERVAL == 0) {
+                            appendCheckpoint(shard, scanned, previous);
+                        }
+                    })) {
+                    return false;
+                }
+                if (archived % CHECKPOINT_INTERVAL != 0) {
+                    appendCheckpoint(shard, archived, previous);
+                }
+            }
+        }
+    } else {
+        bool matches = archived + start == (hasHead ? signedHead.sequence : 0);
+        for (size_t i = 0; i < start && matches; ++i) {
+            matches = !transactions[i].hash.empty();
+        }
+        if (matches && hasHead && start > 0) {
+            matches = transactions[start - 1].hash == signedHead.hash;
+        }
+        if (!matches) {
+            cerr << "Error: Shard " << shard << " ledger does not match its signed head"
+                 << (fresh > 0 ? "; new records were left unsealed" : "") << ". Run --verify-ledger.\n";
+            return false;
+        }
+    }
+    for (size_t i = start; i < transactions.size(); ++i) {
+        transactions[i].hash = transactions[i].chainHash(previous);
+        previous = transactions[i].hash;
+        if ((archived + i + 1) % CHECKPOINT_INTERVAL == 0) {
+            appendCheckpoint(shard, archived + i + 1, previous);
+        }
+    }
+    head.sequence = archived + transactions.size();
+    head.hash = previous;
+    head.signature = signHead(key, head.sequence, head.hash);
+    return true;
+}
+bool FileHandler::adoptUnsealedRecords() {
+    int count = getShardCount();
+    bool sealed = true;
+    for (int i = 0; i < count; ++i) {
+        lock_guard<mutex> guard(shardLock(i));
+        string path = shardFile(TRANSACTIONS_FILE, i, count);
+        bool intact;
+        auto transactions = loadTransactionsFrom(path, intact);
+        LedgerCheckpoint head;
+        if (!intact || !sealLedger(i, transactions, 0, true, head)) {
+            sealed = false;
+            continue;
+        }
+        if (saveTransactionsTo(path, transactions)) {
+            writeHead(i, head);
+        }
+    }
+    return sealed;
+}
+LedgerAudit FileHandler::verifyLedger(bool adopting) {
+    struct Segment {
+        int shard;
+        size_t begin;
+        size_t end;
+        string previous;
+        const LedgerCheckpoint* seal;
+        bool head;
+    };
+    int count = getShardCount();
+    string key = ledgerKey();
+    if (key.empty()) {
+        LedgerAudit audit = {0, 0, 0, 0, {}};
+        audit.failures.push_back("ledger key unavailable: set " + LEDGER_KEY_ENV + " to a key file outside the data directory");
+        return audit;
+    }
+    vector<vector<Transaction>> ledgers(count);
+    vector<vector<LedgerCheckpoint>> checkpoints(count);
+    vector<LedgerCheckpoint> heads(count);
+    vector<char> hasHead(count, 0);
+    vector<size_t> archived(count, 0);
+    vector<char> intact(count, 1);
+    vector<thread> loaders;
+    for (int i = 0; i < count; ++i) {
+        loaders.emplace_back([&ledgers, &checkpoints, &heads, &hasHead, &archived, &intact, i, count]() {
+            bool archiveIntact;
+            ledgers[i] = loadLedgerShard(i, archiveIntact);
+            intact[i] = archiveIntact;
+            checkpoints[i] = loadCheckpoints(i);
+            stable_sort(checkpoints[i].begin(), checkpoints[i].end(), [](const LedgerCheckpoint& a, const LedgerCheckpoint& b) {
+                return a.sequence < b.sequence;
+            });
+            hasHead[i] = loadHead(i, heads[i]);
+            archived[i] = LedgerArchive::recordCount(shardFile(ARCHIVE_FILE, i, count));
+        });
+    }
+    for (auto& loader : loaders) {
+        loader.join();
+    }
+    LedgerAudit audit = {0, 0, 0, 0, {}};
+    vector<Segment> segments;
+    for (int i = 0; i < count; ++i) {
+        const vector<Transaction>& ledger = ledgers[i];
+        audit.records += ledger.size();
+        if (!intact[i]) {
+            stringstream failure;
+            failure << "shard " << i << ": corrupt archive or malformed records, ledger unreadable";
+            audit.failures.push_back(failure.str());
+            continue;
+        }
+        const LedgerCheckpoint& head = heads[i];
+        bool headValid = false;
+        if (hasHead[i]) {
+            stringstream failure;
+            failure << "shard " << i << " head " << head.sequence << ": ";
+            if (signHead(key, head.sequence, head.hash) != head.signature) {
+                failure << "bad signature";
+                audit.failures.push_back(failure.str());
+            } else if (head.sequence > ledger.size()) {
+                failure << "ledger truncated to " << ledger.size() << " record(s)";
+                audit.failures.push_back(failure.str());
+            } else {
+                headValid = true;
+            }
+        } else if (!adopting && (!ledger.empty() || !checkpoints[i].empty())) {
+            stringstream failure;
+            failure << "shard " << i << ": signed head missing";
+            audit.failures.push_back(failure.str());
+        }
+        size_t covered = headValid ? head.sequence : 0;
+        if (ledger.size() > covered) {
+            audit.unsealed += ledger.size() - covered;
+            if (!adopting && headValid) {
+                stringstream failure;
+                failure << "shard " << i << " records " << covered + 1 << "-" << ledger.size() << ": not covered by the signed head";
+                audit.failures.push_back(failure.str());
+            }
+        }
+        size_t stripped = 0;
+        size_t firstStripped = 0;
+        for (size_t j = archived[i]; j < covered; ++j) {
+            if (ledger[j].hash.empty() && stripped++ == 0) {
+                firstStripped = j;
+            }
+        }
+        if (stripped > 0) {
+            stringstream failure;
+            failure << "shard " << i << " record " << firstStripped + 1 << ": hash missing from " << stripped << " sealed record(s)";
+            audit.failures.push_back(failure.str());
+        }
+        set<size_t> present;
+        size_t begin = 0;
+        string previous = LEDGER_GENESIS;
+        size_t headBase = 0;
+        string headPrevious = LEDGER_GENESIS;
+        for (const auto& checkpoint : checkpoints[i]) {
+            stringstream failure;
+            failure << "shard " << i << " checkpoint " << checkpoint.sequence << ": ";
+            if (signCheckpoint(key, checkpoint.sequence, checkpoint.hash) != checkpoint.signature) {
+                failure << "bad signature";
+                audit.failures.push_back(failure.str());
+                continue;
+            }
+            if (checkpoint.sequence > ledger.size()) {
+                failure << "ledger truncated to " << ledger.size() << " record(s)";
+                audit.failures.push_back(failure.str());
+                continue;
+            }
+            if (checkpoint.sequence < begin) {
+                failure << "out of order";
+                audit.failures.push_back(failure.str());
+                continue;
+            }
+            audit.checkpoints++;
+            present.insert(checkpoint.sequence);
+            segments.push_back({i, begin, checkpoint.sequence, previous, &checkpoint, false});
+            begin = checkpoint.sequence;
+            previous = checkpoint.hash;
+            if (begin <= covered) {
+                headBase = begin;
+                headPrevious = previous;
+            }
+        }
+        for (size_t sequence = CHECKPOINT_INTERVAL; sequence <= covered; sequence += CHECKPOINT_INTERVAL) {
+            if (!present.count(sequence)) {
+                stringstream failure;
+                failure << "shard " << i << " checkpoint " << sequence << ": missing";
+                audit.failures.push_back(failure.str());
+            }
+        }
+        if (archived[i] > 0 && archived[i] <= covered && !present.count(archived[i])) {
+            stringstream failure;
+            failure << "shard " << i << " checkpoint " << archived[i] << ": archive boundary missing";
+            audit.failures.push_back(failure.str());
+        }
+        if (headValid) {
+            segments.push_back({i, headBase, covered, headPrevious, &head, true});
+            if (covered >= begin) {
+                begin = covered;
+                previous = head.hash;
+            }
+        }
+        if (begin < ledger.size()) {
+            segments.push_back({i, begin, ledger.size(), previous, nullptr, false});
+        }
+    }
+    audit.segments = segments.size();
+    atomic<size_t> next(0);
+    mutex failuresLock;
+    auto verify = [&]() {
+        for (size_t s = next++; s < segments.size(); s = next++) {
+            const Segment& segment = segments[s];
+            const vector<Transaction>& ledger = ledgers[segment.shard];
+            string previous = segment.previous;
+            string failure;
+            for (size_t j = segment.begin; j < segment.end && failure.empty(); ++j) {
+                previous = ledger[j].chainHash(previous);
+                if (!ledger[j].hash.empty() && ledger[j].hash != previous) {
+                    stringstream ss;
+                    ss << "shard " << segment.shard << " record " << j + 1 << " (" << ledger[j].accountNumber
+                       << " " << ledger[j].timestamp << "): hash mismatch";
+                    failure = ss.str();
+                }
+            }
+            if (failure.empty() && segment.seal && segment.seal->hash != previous) {
+                stringstream ss;
+                ss << "shard " << segment.shard << (segment.head ? " head " : " checkpoint ") << segment.end << ": records "
+                   << segment.begin + 1 << "-" << segment.end << " do not match";
+                failure = ss.str();
+            }
+            if (!failure.empty()) {
+                lock_guard<mutex> guard(failuresLock);
+                audit.failures.push_back(failure);
+            }
+        }
+    };
+    unsigned int threads = max(1u, min(thread::hardware_concurrency(), static_cast<unsigned int>(segments.size())));
+    vector<thread> workers;
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.emplace_back(verify);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    sort(audit.failures.begin(), audit.failures.end());
+    return audit;
+}
+vector<string> FileHandler::loadTransactions(const string& accountNumber) {
+    vector<string> transactions;
+    int shard = shardOf(accountNumber);
+    vector<Transaction> shardTransactions;
+    {
+        lock_guard<mutex> guard(shardLock(shard));
+        LedgerArchive::scan(shardFile(ARCHIVE_FILE, shard, getShardCount()), accountNumber,
+                            [&shardTransactions](const Transaction& trans) {
+            shardTransactions.push_back(trans);
+        });
+        auto hot = loadTransactionsFrom(shardFile(TRANSACTIONS_FILE, shard, getShardCount()));
+        shardTransactions.insert(shardTransactions.end(), hot.begin(), hot.end());
+    }
+    for (const auto& trans : shardTransactions) {
+        if (trans.accountNumber == accountNumber) {
+            stringstream formatted;
+            formatted << left << setw(19) << trans.timestamp << "| "
+                     << setw(18) << trans.type << "| $"
+                     << setw(9) << trans.amount << "| $"
+                     << trans.balance;
+            transactions.push_back(formatted.str());
+        }
+    }
+    return transactions;
+}
+bool FileHandler::commitBatch(const vector<User>& users, const vector<Transaction>& transactions, vector<LedgerPosition>& positions) {
+    lock_guard<mutex> guard(journalLock);
+    if (filesystem::exists(dataPath(JOURNAL_FILE))) {
+        cerr << "Error: An earlier batch is still pending in " << dataPath(JOURNAL_FILE) << "; restart to recover it.\n";
+        return false;
+    }
+    ofstream journal(dataPath(JOURNAL_FILE));
+    if (!journal.is_open()) {
+        cerr << "Error: Could not open journal file.\n";
+        return false;
+    }
+    journal << "[\n";
+    for (const auto& user : users) {
+        journal << "{\"user\":" << user.toJson() << "},\n";
+    }
+    for (const auto& trans : transactions) {
+        journal << "{\"transaction\":" << trans.toJson() << "},\n";
+    }
+    journal << "{\"commit\":true}\n";
+    journal << "]\n";
+    journal.close();
+    if (journal.fail()) {
+        cerr << "Error: Could not write journal file.\n";
+        remove(dataPath(JOURNAL_FILE).c_str());
+        return false;
+    }
+    bool written;
+    if (applyBatch(users, transactions, false, positions, written)) {
+        remove(dataPath(JOURNAL_FILE).c_str());
+        return true;
+    }
+    // Once a shard has been replaced the batch can only be finished by replaying the journal.
+    if (written) {
+        cerr << "Error: Batch only partly applied; it stays in " << dataPath(JOURNAL_FILE) << " and is completed on restart.\n";
+    } else {
+        remove(dataPath(JOURNAL_FILE).c_str());
+    }
+    positions.clear();
+    return false;
+}
+void FileHandler::recoverArchives() {
+    int count = getShardCount();
+    for (int i = 0; i < count; ++i) {
+        lock_guard<mutex> guard(shardLock(i));
+        string archiveTemp = shardFile(ARCHIVE_FILE, i, count) + TEMP_SUFFIX;
+        string hotTemp = shardFile(TRANSACTIONS_FILE, i, count) + TEMP_SUFFIX;
+        error_code error;
+        if (filesystem::exists(archiveTemp)) {
+            filesystem::remove(archiveTemp, error);
+            filesystem::remove(hotTemp, error);
+        } else if (filesystem::exists(hotTemp)) {
+            filesystem::rename(hotTemp, shardFile(TRANSACTIONS_FILE, i, count), error);
+        }
+        if (error) {
+            cerr << "Error: Could not recover archive staging files for shard " << i << ".\n";
+        }
+    }
+}
+void FileHandler::recoverJournal() {
+    lock_guard<mutex> guard(journalLock);
+    recoverArchives();
+    int count = getShardCount();
+    for (int i = 0; i < count; ++i) {
+        lock_guard<mutex> shardGuard(shardLock(i));
+        remove((shardFile(USERS_FILE, i, count) + BATCH_SUFFIX).c_str());
+        remove((shardFile(TRANSACTIONS_FILE, i, count) + BATCH_SUFFIX).c_str());
+    }
+    ifstream journal(dataPath(JOURNAL_FILE));
+    if (!journal.is_open()) {
+        return;
+    }
+    vector<User> users;
+    vector<Transaction> transactions;
+    bool committed = false;
+    bool malformed = false;
+    string line;
+    while (getline(journal, line)) {
+        if (line.empty() || line == "[" || line == "]") {
+            continue;
+        }
+        if (line.back() == ',') {
+            line.pop_back();
+        }
+        if (line.compare(0, 8, "{\"user\":") == 0) {
+            users.emplace_back();
+            malformed = !User::fromJson(line.substr(8), users.back()) || malformed;
+        } else if (line.compare(0, 15, "{\"transaction\":") == 0) {
+            transactions.emplace_back();
+            malformed = !Transaction::fromJson(line.substr(15), transactions.back()) || malformed;
+        } else if (line == "{\"commit\":true}") {
+            committed = true;
+        }
+    }
+    journal.close();
+    if (committed && malformed) {
+        string rejected = dataPath(JOURNAL_FILE) + ".rejected";
+        rename(dataPath(JOURNAL_FILE).c_str(), rejected.c_str());
+        cerr << "Error: Journal has malformed records; it was moved to " << rejected << " and not replayed.\n";
+        return;
+    }
+    vector<LedgerPosition> positions;
+    bool written;
+    if (committed && !applyBatch(users, transactions, true, positions, written)) {
+        cerr << "Error: Journal not replayed; it stays in " << dataPath(JOURNAL_FILE) << " until the ledger is repaired.\n";
+        return;
+    }
+    remove(dataPath(JOURNAL_FILE).c_str());
+}
+bool FileHandler::applyBatch(const vector<User>& users, const vector<Transaction>& transactions, bool replay,
+                             vector<LedgerPosition>& positions, bool& written) {
+    int count = getShardCount();
+    vector<vector<User>> dirtyUsers(count);
+    vector<vector<Transaction>> dirtyTransactions(count);
+    for (const auto& user : users) {
+        dirtyUsers[shardOf(user.getAccountNumber())].push_back(user);
+    }
+    for (const auto& trans : transactions) {
+        dirtyTransactions[shardOf(trans.accountNumber)].push_back(trans);
+    }
+    vector<int> shards;
+    set<int> slots;
+    for (int i = 0; i < count; ++i) {
+        if (!dirtyUsers[i].empty() || !dirtyTransactions[i].empty()) {
+            shards.push_back(i);
+            slots.insert(i % SHARD_LOCKS);
+        }
+    }
+    vector<unique_lock<mutex>> guards;
+    for (int slot : slots) {
+        guards.emplace_back(shardLocks[slot]);
+    }
+    auto forEachShard = [&shards](const function<void(int)>& work) {
+        vector<thread> workers;
+        for (int i : shards) {
+            workers.emplace_back(work, i);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    };
+    written = false;
+    vector<vector<Transaction>> ledgers(count);
+    vector<char> ok(count, 1);
+    forEachShard([&](int i) {
+        if (!dirtyTransactions[i].empty()) {
+            string path = shardFile(TRANSACTIONS_FILE, i, count);
+            bool intact;
+            ledgers[i] = loadTransactionsFrom(path, intact);
+            if (!intact) {
+                cerr << "Error: Batch not applied; repair " << path << " first.\n";
+                ok[i] = 0;
+            }
+        }
+    });
+    if (find(ok.begin(), ok.end(), 0) != ok.end()) {
+        return false;
+    }
+    // Every shard is staged before any is replaced, so a failed write leaves the batch unapplied.
+    vector<vector<LedgerPosition>> shardPositions(count);
+    vector<LedgerCheckpoint> heads(count);
+    vector<char> sealed(count, 0);
+    forEachShard([&](int i) {
+        if (!dirtyUsers[i].empty()) {
+            string path = shardFile(USERS_FILE, i, count);
+            ok[i] = mergeUserRows(path, path + BATCH_SUFFIX, dirtyUsers[i]);
+        }
+        if (!dirtyTransactions[i].empty() && ok[i]) {
+            vector<Transaction>& shardTransactions = ledgers[i];
+            unordered_set<string> applied;
+            if (replay) {
+                for (const auto& trans : shardTransactions) {
+                    applied.insert(trans.canonical());
+                }
+            }
+            size_t archived = LedgerArchive::recordCount(shardFile(ARCHIVE_FILE, i, count));
+            size_t existing = shardTransactions.size();
+            for (const auto& trans : dirtyTransactions[i]) {
+                if (!replay || applied.count(trans.canonical()) == 0) {
+                    shardPositions[i].push_back({i, archived + shardTransactions.size()});
+                    shardTransactions.push_back(trans);
+                    shardTransactions.back().hash.clear();
+                }
+            }
+            sealed[i] = sealLedger(i, shardTransactions, shardTransactions.size() - existing, false, heads[i]);
+            ok[i] = saveTransactionsTo(shardFile(TRANSACTIONS_FILE, i, count) + BATCH_SUFFIX, shardTransactions);
+        }
+    });
+    if (find(ok.begin(), ok.end(), 0) != ok.end()) {
+        cerr << "Error: Batch not applied; could not stage its shard files.\n";
+        for (int i : shards) {
+            remove((shardFile(USERS_FILE, i, count) + BATCH_SUFFIX).c_str());
+            remove((shardFile(TRANSACTIONS_FILE, i, count) + BATCH_SUFFIX).c_str());
+        }
+        return false;
+    }
+    bool complete = true;
+    for (int i : shards) {
+        error_code error;
+        for (const string& file : {USERS_FILE, TRANSACTIONS_FILE}) {
+            string path = shardFile(file, i, count);
+            if (!error && filesystem::exists(path + BATCH_SUFFIX)) {
+                filesystem::rename(path + BATCH_SUFFIX, path, error);
+                written = written || !error;
+            }
+        }
+        if (error) {
+            cerr << "Error: Could not replace the files of shard " << i << ".\n";
+            complete = false;
+            continue;
+        }
+        if (!dirtyTransactions[i].empty()) {
+            if (sealed[i]) {
+                writeHead(i, heads[i]);
+            }
+            setLedgerSize(i, ledgers[i].size());
+            positions.insert(positions.end(), shardPositions[i].begin(), shardPositions[i].end());
+        }
+    }
+    return complete;
+}
+bool FileHandler::rebalanceShards(int newCount) {
+    if (newCount < 1) {
+        return false;
+    }
+    recoverJournal();
+    if (filesystem::exists(dataPath(JOURNAL_FILE))) {
+        cerr << "Error: Shards not rebalanced; a batch is still pending in " << dataPath(JOURNAL_FILE) << ".\n";
+        return false;
+    }
+    int oldCount = getShardCount();
+    if (newCount == oldCount) {
+        return true;
+    }
+    bool keyed = !signingKey().empty();
+    bool sealed = false;
+    for (int i = 0; i < oldCount; ++i) {
+        sealed = sealed || hasSeals(i, oldCount);
+    }
+    // An unkeyed ledger that was never sealed has nothing to verify; it is moved and stays unsealed.
+    LedgerAudit audit = keyed || sealed ? verifyLedger(false) : LedgerAudit{0, 0, 0, 0, {}};
+    if (!audit.failures.empty()) {
+        cerr << "Error: Shards not rebalanced; the ledger failed verification:\n";
+        for (size_t i = 0; i < audit.failures.size() && i < 20; ++i) {
+            cerr << "  " << audit.failures[i] << "\n";
+        }
+        if (keyed) {
+            cerr << "If these records were written before the ledger key was set, run --seal-ledger first.\n";
+        }
+        return false;
+    }
+    bool intact;
+    auto users = loadAllUsers(intact);
+    if (!intact) {
+        cerr << "Error: Shards not rebalanced; repair the rejected accounts first.\n";
+        return false;
+    }
+    vector<Transaction> archived, transactions;
+    for (int i = 0; i < oldCount; ++i) {
+        bool archiveIntact = LedgerArchive::scan(shardFile(ARCHIVE_FILE, i, oldCount), "", [&archived](const Transaction& trans) {
+            archived.push_back(trans);
+        });
+        auto shard = loadTransactionsFrom(shardFile(TRANSACTIONS_FILE, i, oldCount), intact);
+        if (!archiveIntact || !intact) {
+            cerr << "Error: Shards not rebalanced; repair the ledger of shard " << i << " first.\n";
+            return false;
+        }
+        transactions.insert(transactions.end(), shard.begin(), shard.end());
+    }
+    shardCount = newCount;
+    {
+        lock_guard<mutex> guard(ledgerSizesLock);
+        ledgerSizes.clear();
+    }
+    for (int i = 0; i < newCount; ++i) {
+        remove(shardFile(USERS_FILE, i, newCount).c_str());
+    }
+    saveAllUsers(users);
+    vector<vector<Transaction>> cold(newCount), shards(newCount);
+    for (const auto& trans : archived) {
+        cold[shardOf(trans.accountNumber)].push_back(trans);
+    }
+    for (const auto& trans : transactions) {
+        shards[shardOf(trans.accountNumber)].push_back(trans);
+    }
+    for (int i = 0; i < newCount; ++i) {
+        remove(shardFile(ARCHIVE_FILE, i, newCount).c_str());
+        remove(shardFile(CHECKPOINTS_FILE, i, newCount).c_str());
+        remove(shardFile(HEAD_FILE, i, newCount).c_str());
+        if (!cold[i].empty() && !LedgerArchive::append(shardFile(ARCHIVE_FILE, i, newCount), cold[i])) {
+            cerr << "Error: Could not write the archive of shard " << i << ".\n";
+            shardCount = oldCount;
+            return false;
+        }
+        for (auto& trans : shards[i]) {
+            trans.hash.clear();
+        }
+        // The old layout was verified above, so the new shard is sealed from its archive onwards.
+        LedgerCheckpoint head;
+        bool sealed = sealLedger(i, shards[i], shards[i].size(), true, head);
+        if (saveTransactionsTo(shardFile(TRANSACTIONS_FILE, i, newCount), shards[i]) && sealed) {
+            writeHead(i, head);
+        }
+    }
+    ofstream config(dataPath(SHARDS_CONFIG_FILE));
+    if (!config.is_open()) {
+        cerr << "Error: Could not open shard config file.\n";
+        shardCount = oldCount;
+        return false;
+    }
+    config << newCount << "\n";
+    config.close();
+    for (int i = 0; i < oldCount; ++i) {
+        remove(shardFile(USERS_FILE, i, oldCount).c_str());
+        remove(shardFile(TRANSACTIONS_FILE, i, oldCount).c_str());
+        remove(shardFile(ARCHIVE_FILE, i, oldCount).c_str());
+        remove(shardFile(CHECKPOINTS_FILE, i, oldCount).c_str());
+        remove(shardFile(HEAD_FILE, i, oldCount).c_str());
+    }
+    return true;
+}
+const size_t LedgerArchive::BLOCK_RECORDS;
+const char LedgerArchive::MAGIC[4] = {'B', 'K', 'A', '1'};
+void LedgerArchive::putVarint(string& out, unsigned long long value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+bool LedgerArchive::readVarint(istream& in, size_t& pos, unsigned long long& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == EOF) {
+            return false;
+        }
+        pos++;
+        value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+bool LedgerArchive::getVarint(const string& in, size_t& pos, unsigned long long& value) {
+    value = 0;
+    for (int shift = 0; pos < in.size() && shift < 64; shift += 7) {
+        unsigned char byte = static_cast<unsigned char>(in[pos++]);
+        value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+unsigned long long LedgerArchive::zigzag(long long value) {
+    return (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63);
+}
+long long LedgerArchive::unzigzag(unsigned long long value) {
+    return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+}
+string LedgerArchive::compress(const string& in) {
+    string out;
+    vector<int> table(1 << 14, -1);
+    size_t literalStart = 0;
+    size_t i = 0;
+    while (i + 4 <= in.size()) {
+        unsigned int word;
+        memcpy(&word, in.data() + i, 4);
+        unsigned int slot = (word * 2654435761u) >> 18;
+        int candidate = table[slot];
+        table[slot] = static_cast<int>(i);
+        if (candidate >= 0 && i - candidate < (1u << 16) && memcmp(in.data() + candidate, in.data() + i, 4) == 0) {
+            size_t length = 4;
+            while (i + length < in.size() && in[candidate + length] == in[i + length]) {
+                length++;
+            }
+            putVarint(out, i - literalStart);
+            out.append(in, literalStart, i - literalStart);
+            putVarint(out, length);
+            putVarint(out, i - candidate);
+            i += length;
+            literalStart = i;
+        } else {
+            i++;
+        }
+    }
+    putVarint(out, in.size() - literalStart);
+    out.append(in, literalStart, string::npos);
+    putVarint(out, 0);
+    return out;
+}
+bool LedgerArchive::decompress(const string& in, string& out) {
+    out.clear();
+    size_t pos = 0;
+    unsigned long long literals, length, distance;
+    while (getVarint(in, pos, literals)) {
+        if (literals > in.size() - pos || literals > MAX_BLOCK_BYTES - out.size()) {
+            return false;
+        }
+        out.append(in, pos, literals);
+        pos += literals;
+        if (!getVarint(in, pos, length)) {
+            return false;
+        }
+        if (length == 0) {
+            return pos == in.size();
+        }
+        if (!getVarint(in, pos, distance) || distance == 0 || distance > out.size() ||
+            length > MAX_BLOCK_BYTES - out.size()) {
+            return false;
+        }
+        size_t start = out.size() - distance;
+        for (size_t i = 0; i < length; ++i) {
+            out.push_back(out[start + i]);
+        }
+    }
+    return false;
+}
+string LedgerArchive::encodeBlock(const Transaction* transactions, size_t count) {
+    unordered_map<string, size_t> accounts, types;
+    vector<string> accountNames, typeNames;
+    string accountColumn, typeColumn, timeColumn, amountColumn, balanceColumn, irregular;
+    unordered_map<size_t, long long> lastBalance;
+    long long lastTime = 0;
+    size_t irregularCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Transaction& trans = transactions[i];
+        auto account = accounts.emplace(trans.accountNumber, accountNames.size());
+        if (account.second) {
+            accountNames.push_back(trans.accountNumber);
+        }
+        auto type = types.emplace(trans.type, typeNames.size());
+        if (type.second) {
+            typeNames.push_back(trans.type);
+        }
+        putVarint(accountColumn, account.first->second);
+        putVarint(typeColumn, type.first->second);
+        time_t when = FileHandler::parseTimestamp(trans.timestamp);
+        if (when < 0 || FileHandler::formatTimestamp(when) != trans.timestamp) {
+            putVarint(timeColumn, zigzag(0));
+            putVarint(irregular, i);
+            putVarint(irregular, trans.timestamp.size());
+            irregular += trans.timestamp;
+            irregularCount++;
+        } else {
+            putVarint(timeColumn, zigzag(when - lastTime));
+            lastTime = when;
+        }
+        long long amount = trans.amount.cents();
+        long long balance = trans.balance.cents();
+        putVarint(amountColumn, zigzag(amount));
+        long long& previous = lastBalance[account.first->second];
+        putVarint(balanceColumn, zigzag(balance - previous));
+        previous = balance;
+    }
+    string block;
+    putVarint(block, count);
+    for (const vector<string>* dictionary : {&accountNames, &typeNames}) {
+        putVarint(block, dictionary->size());
+        for (const auto& entry : *dictionary) {
+            putVarint(block, entry.size());
+            block += entry;
+        }
+    }
+    putVarint(block, irregularCount);
+    block += irregular;
+    block += accountColumn + typeColumn + timeColumn + amountColumn + balanceColumn;
+    return block;
+}
+bool LedgerArchive::decodeBlock(const string& block, const string& accountNumber, const function<void(const Transaction&)>& visit, size_t& records) {
+    size_t pos = 0;
+    unsigned long long count, entries, length, index, value;
+    if (!getVarint(block, pos, count) || count == 0 || count > BLOCK_RECORDS) {
+        return false;
+    }
+    vector<string> dictionaries[2];
+    for (auto& dictionary : dictionaries) {
+        if (!getVarint(block, pos, entries) || entries == 0 || entries > count) {
+            return false;
+        }
+        for (size_t i = 0; i < entries; ++i) {
+            if (!getVarint(block, pos, length) || length > block.size() - pos) {
+                return false;
+            }
+            dictionary.push_back(block.substr(pos, length));
+            pos += length;
+        }
+    }
+    const vector<string>& accountNames = dictionaries[0];
+    const vector<string>& typeNames = dictionaries[1];
+    long long wanted = -1;
+    if (!accountNumber.empty()) {
+        auto it = find(accountNames.begin(), accountNames.end(), accountNumber);
+        if (it == accountNames.end()) {
+            records = count;
+            return true;
+        }
+        wanted = it - accountNames.begin();
+    }
+    unordered_map<size_t, string> irregular;
+    if (!getVarint(block, pos, entries) || entries > count) {
+        return false;
+    }
+    for (size_t i = 0; i < entries; ++i) {
+        if (!getVarint(block, pos, index) || index >= count || !getVarint(block, pos, length) ||
+            length > block.size() - pos) {
+            return false;
+        }
+        irregular[index] = block.substr(pos, length);
+        pos += length;
+    }
+    vector<size_t> accountColumn(count), typeColumn(count);
+    vector<long long> timeColumn(count), amountColumn(count), balanceColumn(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (!getVarint(block, pos, value) || value >= accountNames.size()) return false;
+        accountColumn[i] = value;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!getVarint(block, pos, value) || value >= typeNames.size()) return false;
+        typeColumn[i] = value;
+    }
+    for (vector<long long>* column : {&timeColumn, &amountColumn, &balanceColumn}) {
+        for (auto& entry : *column) {
+            if (!getVarint(block, pos, value)) return false;
+            entry = unzigzag(value);
+        }
+    }
+    if (pos != block.size()) {
+        return false;
+    }
+    long long when = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (irregular.count(i)) {
+            continue;
+        }
+        if (timeColumn[i] < -MAX_TIMESTAMP || timeColumn[i] > MAX_TIMESTAMP) {
+            return false;
+        }
+        when += timeColumn[i];
+        if (when < 0 || when > MAX_TIMESTAMP) {
+            return false;
+        }
+        timeColumn[i] = when;
+    }
+    vector<long long> lastBalance(accountNames.size(), 0);
+    for (size_t i = 0; i < count; ++i) {
+        long long balance = lastBalance[accountColumn[i]] += balanceColumn[i];
+        if (wanted >= 0 && static_cast<long long>(accountColumn[i]) != wanted) {
+            continue;
+        }
+        auto raw = irregular.find(i);
+        string timestamp = raw != irregular.end() ? raw->second : FileHandler::formatTimestamp(static_cast<time_t>(timeColumn[i]));
+        Transaction trans = {timestamp, accountNames[accountColumn[i]], typeNames[typeColumn[i]],
+                             Money::fromCents(amountColumn[i]), Money::fromCents(balance), ""};
+        visit(trans);
+    }
+    records = count;
+    return true;
+}
+size_t LedgerArchive::recordCount(const string& path) {
+    ifstream file(path, ios::binary);
+    return readHeader(file);
+}
+size_t LedgerArchive::readHeader(istream& in) {
+    char header[12];
+    if (!in.read(header, sizeof(header)) || memcmp(header, MAGIC, 4) != 0) {
+        return 0;
+    }
+    unsigned long long count = 0;
+    for (int i = 11; i >= 4; --i) {
+        count = (count << 8) | static_cast<unsigned char>(header[i]);
+    }
+    return static_cast<size_t>(count);
+}
+bool LedgerArchive::append(const string& path, const vector<Transaction>& transactions) {
+    unsigned long long count = recordCount(path) + transactions.size();
+    char header[12];
+    memcpy(header, MAGIC, 4);
+    for (int i = 4; i < 12; ++i, count >>= 8) {
+        header[i] = static_cast<char>(count & 0xFF);
+    }
+    fstream file(path, ios::in | ios::out | ios::binary);
+    if (!file.is_open()) {
+        file.open(path, ios::out | ios::binary);
+    }
+    if (!file.is_open()) {
+        cerr << "Error: Could not open archive file.\n";
+        return false;
+    }
+    file.seekp(0, ios::end);
+    if (file.tellp() < static_cast<streamoff>(sizeof(header))) {
+        file.seekp(0);
+        file.write(header, sizeof(header));
+    }
+    for (size_t start = 0; start < transactions.size(); start += BLOCK_RECORDS) {
+        string block = compress(encodeBlock(transactions.data() + start, min(BLOCK_RECORDS, transactions.size() - start)));
+        string frame;
+        putVarint(frame, block.size());
+        file.write(frame.data(), frame.size());
+        file.write(block.data(), block.size());
+    }
+    file.seekp(0);
+    file.write(header, sizeof(header));
+    file.close();
+    return true;
+}
+bool LedgerArchive::scan(const string& path, const string& accountNumber, const function<void(const Transaction&)>& visit) {
+    // The header is read from the same handle as the blocks, so a concurrent archive move cannot split them.
+    ifstream file(path, ios::binary);
+    size_t expected = readHeader(file);
+    if (!file.is_open() || expected == 0) {
+        return true;
+    }
+    file.seekg(0, ios::end);
+    size_t size = static_cast<size_t>(file.tellg());
+    file.seekg(12);
+    size_t pos = 12;
+    size_t decoded = 0;
+    string frame, block;
+    while (pos < size) {
+        size_t start = pos;
+        unsigned long long length;
+        size_t records = 0;
+        bool valid = readVarint(file, pos, length) && length <= size - pos;
+        if (valid) {
+            frame.resize(length);
+            valid = static_cast<bool>(file.read(&frame[0], length));
+            pos += length;
+        }
+        if (!valid || !decompress(frame, block) || !decodeBlock(block, accountNumber, visit, records)) {
+            cerr << "Error: Archive " << path << " has a corrupt block at byte " << start << ".\n";
+            return false;
+        }
+        decoded += records;
+    }
+    if (decoded != expected) {
+        cerr << "Error: Archive " << path << " holds " << decoded << " records but its header claims " << expected << ".\n";
+        return false;
+    }
+    return true;
+}
+UsageLimits::UsageLimits()
+    : hourlyWithdrawal(Money::fromDollars(2000)), dailyWithdrawal(Money::fromDollars(5000)),
+      hourlyDeposit(Money::fromDollars(10000)), dailyDeposit(Money::fromDollars(20000)),
+      velocityCount(3), velocityMinutes(10) {
+}
+bool UsageLimits::set(const string& key, const string& value) {
+    Money amount;
+    bool isAmount = Money::parse(value, amount);
+    if (key == "hourlyWithdrawal" && isAmount) hourlyWithdrawal = amount;
+    else if (key == "dailyWithdrawal" && isAmount) dailyWithdrawal = amount;
+    else if (key == "hourlyDeposit" && isAmount) hourlyDeposit = amount;
+    else if (key == "dailyDeposit" && isAmount) dailyDeposit = amount;
+    else if (key == "velocityCount") velocityCount = atoi(value.c_str());
+    else if (key == "velocityMinutes") velocityMinutes = min(atoi(value.c_str()), RollingWindow::SLOTS);
+    else return false;
+    return true;
+}
+ATMLimits::ATMLimits()
+    : perWithdrawal(Money::fromDollars(1000)), perDeposit(Money::fromDollars(5000)) {
+}
+ATMLimits ATMLimits::load(const string& path) {
+    ATMLimits limits;
+    ifstream file(path);
+    if (!file.is_open()) {
+        return limits;
+    }
+    string line;
+    while (getline(file, line)) {
+        size_t eq = line.find('=');
+        if (line.empty() || line[0] == '#' || eq == string::npos) {
+            continue;
+        }
+        string key = line.substr(0, eq);
+        string value = line.substr(eq + 1);
+        bool known = true;
+        if (key == "perWithdrawal") known = Money::parse(value, limits.perWithdrawal);
+        else if (key == "perDeposit") known = Money::parse(value, limits.perDeposit);
+        else if (key.compare(0, 8, "account.") == 0) known = limits.account.set(key.substr(8), value);
+        else if (key.compare(0, 5, "card.") == 0) known = limits.card.set(key.substr(5), value);
+        else known = limits.account.set(key, value) && limits.card.set(key, value);
+        if (!known) {
+            cerr << "Warning: Ignoring ATM limit '" << line << "'.\n";
+        }
+    }
+    file.close();
+    return limits;
+}
+const int RollingWindow::SLOTS;
+RollingWindow::RollingWindow(long long slotSeconds) : slotSeconds(slotSeconds) {
+    fill(epochs, epochs + SLOTS, -1LL);
+    fill(amounts, amounts + SLOTS, Money());
+    fill(counts, counts + SLOTS, 0);
+}
+void RollingWindow::add(time_t now, Money amount) {
+    long long epoch = now / slotSeconds;
+    int slot = static_cast<int>(epoch % SLOTS);
+    if (epochs[slot] != epoch) {
+        epochs[slot] = epoch;
+        amounts[slot] = Money();
+        counts[slot] = 0;
+    }
+    amounts[slot] += amount;
+    counts[slot]++;
+}
+Money RollingWindow::total(time_t now, int slots) const {
+    long long epoch = now / slotSeconds;
+    Money sum;
+    for (int i = 0; i < SLOTS; ++i) {
+        if (epochs[i] > epoch - slots && epochs[i] <= epoch) {
+            sum += amounts[i];
+        }
+    }
+    return sum;
+}
+int RollingWindow::count(time_t now, int slots) const {
+    long long epoch = now / slotSeconds;
+    int sum = 0;
+    for (int i = 0; i < SLOTS; ++i) {
+        if (epochs[i] > epoch - slots && epochs[i] <= epoch) {
+            sum += counts[i];
+        }
+    }
+    return sum;
+}
+ATMUsage::ATMUsage()
+    : withdrawMinutes(60), withdrawHours(3600), depositMinutes(60), depositHours(3600) {
+}
+void ATMLimiter::configure(const ATMLimits& limits) {
+    lock_guard<mutex> guard(lock);
+    this->limits = limits;
+}
+string ATMLimiter::checkUsage(const ATMUsage& usage, const UsageLimits& scopeLimits, const string& scope, const string& type, Money amount, time_t now) const {
+    stringstream reason;
+    if (type == "ATM_WITHDRAWAL") {
+        if (usage.withdrawMinutes.total(now, 60) + amount > scopeLimits.hourlyWithdrawal) {
+            reason << "Hourly ATM withdrawal limit of $" << scopeLimits.hourlyWithdrawal << " per " << scope << " reached.";
+        } else if (usage.withdrawHours.total(now, 24) + amount > scopeLimits.dailyWithdrawal) {
+            reason << "Daily ATM withdrawal limit of $" << scopeLimits.dailyWithdrawal << " per " << scope << " reached.";
+        } else if (scopeLimits.velocityCount > 0 &&
+                   usage.withdrawMinutes.count(now, scopeLimits.velocityMinutes) >= scopeLimits.velocityCount) {
+            reason << "Too many withdrawals: at most " << scopeLimits.velocityCount << " per " << scope
+                   << " every " << scopeLimits.velocityMinutes << " minutes.";
+        }
+    } else {
+        if (usage.depositMinutes.total(now, 60) + amount > scopeLimits.hourlyDeposit) {
+            reason << "Hourly ATM deposit limit of $" << scopeLimits.hourlyDeposit << " per " << scope << " reached.";
+        } else if (usage.depositHours.total(now, 24) + amount > scopeLimits.dailyDeposit) {
+            reason << "Daily ATM deposit limit of $" << scopeLimits.dailyDeposit << " per " << scope << " reached.";
+        }
+    }
+    return reason.str();
+}
+string ATMLimiter::check(const string& accountNumber, const string& cardNumber, const string& type, Money amount, time_t now) const {
+    lock_guard<mutex> guard(lock);
+    stringstream reason;
+    if (type == "ATM_WITHDRAWAL" && amount > limits.perWithdrawal) {
+        reason << "ATM withdrawal limit is $" << limits.perWithdrawal << " per transaction.";
+        return reason.str();
+    }
+    if (type == "ATM_DEPOSIT" && amount > limits.perDeposit) {
+        reason << "ATM deposit limit is $" << limits.perDeposit << " per transaction.";
+        return reason.str();
+    }
+    auto account = accountUsage.find(accountNumber);
+    if (account != accountUsage.end()) {
+        string accountReason = checkUsage(account->second, limits.account, "account", type, amount, now);
+        if (!accountReason.empty()) {
+            return accountReason;
+        }
+    }
+    auto card = cardNumber.empty() ? cardUsage.end() : cardUsage.find(cardNumber);
+    if (card != cardUsage.end()) {
+        return checkUsage(card->second, limits.card, "card", type, amount, now);
+    }
+    return "";
+}
+void ATMLimiter::record(const string& accountNumber, const string& cardNumber, const string& type, Money amount, time_t now) {
+    lock_guard<mutex> guard(lock);
+    for (ATMUsage* usage : {&accountUsage[accountNumber], cardNumber.empty() ? nullptr : &cardUsage[cardNumber]}) {
+        if (!usage) {
+            continue;
+        }
+        if (type == "ATM_WITHDRAWAL") {
+            usage->withdrawMinutes.add(now, amount);
+            usage->withdrawHours.add(now, amount);
+        } else {
+            usage->depositMinutes.add(now, amount);
+            usage->depositHours.add(now, amount);
+        }
+    }
+}
+void ATMLimiter::rebuild(const vector<User>& users, const vector<Transaction>& transactions, time_t now) {
+    {
+        lock_guard<mutex> guard(lock);
+        accountUsage.clear();
+        cardUsage.clear();
+    }
+    unordered_map<string, string> cards;
+    for (const auto& user : users) {
+        if (user.getHasCard()) {
+            cards[user.getAccountNumber()] = user.getCardNumber();
+        }
+    }
+    for (const auto& trans : transactions) {
+        if (trans.type != "ATM_WITHDRAWAL" && trans.type != "ATM_DEPOSIT") {
+            continue;
+        }
+        time_t when = FileHandler::parseTimestamp(trans.timestamp);
+        if (when < 0 || when > now || now - when >= 24 * 3600) {
+            continue;
+        }
+        auto card = cards.find(trans.accountNumber);
+        record(trans.accountNumber, card != cards.end() ? card->second : "", trans.type, trans.amount, when);
     }
-    file << "]\n";
-    file.close();
 }
-void FileHandler::saveUser(const User& user) {
-    auto users = loadAllUsers();
-    bool found = false;
-    for (auto& u : users) {
-        if (u.getAccountNumber() == user.getAccountNumber()) {
-            u = user;
-            found = true;
-            break;
-        }
+Snapshot::Snapshot() : count(0) {
+}
+size_t Snapshot::accountCount() const {
+    return count;
+}
+void Snapshot::forEachAccount(const function<void(const User&)>& visit) const {
+    for (size_t i = 0; i < count; ++i) {
+        visit((*pages[i / SNAPSHOT_PAGE_SIZE])[i % SNAPSHOT_PAGE_SIZE]);
     }
-    if (!found) {
-        users.push_back(user);
+}
+void Snapshot::forEachTransaction(const function<void(const Transaction&)>& visit) const {
+    for (size_t shard = 0; shard < ledgerSizes.size(); ++shard) {
+        FileHandler::readLedgerShard(static_cast<int>(shard), ledgerSizes[shard], visit);
     }
-    saveAllUsers(users);
 }
-void FileHandler::saveAllUsers(const vector<User>& users) {
-    ofstream file(USERS_FILE);
-    if (!file.is_open()) {
-        cerr << "Error: Could not open users file.\n";
-        return;
+void Snapshot::release() {
+    pages.clear();
+    count = 0;
+    ledgerSizes.clear();
+}
+SnapshotStore::SnapshotStore() : count(0) {
+}
+void SnapshotStore::store(size_t index, const User& user) {
+    size_t page = index / SNAPSHOT_PAGE_SIZE;
+    while (pages.size() <= page) {
+        pages.push_back(make_shared<vector<User>>(SNAPSHOT_PAGE_SIZE));
     }
-    file << "[\n";
+    if (pages[page].use_count() > 1) {
+        pages[page] = make_shared<vector<User>>(*pages[page]);
+    }
+    (*pages[page])[index % SNAPSHOT_PAGE_SIZE] = user;
+    count = max(count, index + 1);
+}
+void SnapshotStore::reset(const vector<User>& users) {
+    lock_guard<mutex> guard(lock);
+    pages.clear();
+    count = 0;
     for (size_t i = 0; i < users.size(); ++i) {
-        file << users[i].toJson();
-        if (i != users.size() - 1) {
-            file << ",";
-        }
-        file << "\n";
+        store(i, users[i]);
     }
-    file << "]\n";
-    file.close();
+    ledgerSizes = FileHandler::getLedgerSizes();
+    pending.clear();
 }
-vector<User> FileHandler::loadAllUsers() {
-    vector<User> users;
-    ifstream file(USERS_FILE);
-    if (!file.is_open()) {
-        return users;
+void SnapshotStore::publish(const vector<pair<size_t, User>>& accounts, const vector<LedgerPosition>& rows) {
+    lock_guard<mutex> guard(lock);
+    pending.push_back({accounts, rows});
+    vector<bool> ready(pending.size(), true);
+    vector<size_t> visible;
+    for (bool changed = true; changed;) {
+        changed = false;
+        vector<unordered_set<size_t>> written(ledgerSizes.size());
+        for (size_t c = 0; c < pending.size(); ++c) {
+            for (const auto& row : pending[c].rows) {
+                if (row.shard < 0) {
+                    continue;
+                }
+                if (static_cast<size_t>(row.shard) >= written.size()) {
+                    written.resize(row.shard + 1);
+                }
+                if (ready[c]) {
+                    written[row.shard].insert(row.sequence);
+                }
+            }
+        }
+        visible.assign(written.size(), 0);
+        for (size_t shard = 0; shard < written.size(); ++shard) {
+            visible[shard] = shard < ledgerSizes.size() ? ledgerSizes[shard] : 0;
+            while (written[shard].count(visible[shard])) {
+                visible[shard]++;
+            }
+        }
+        for (size_t c = 0; c < pending.size(); ++c) {
+            for (const auto& row : pending[c].rows) {
+                if (ready[c] && row.shard >= 0 && row.sequence >= visible[row.shard]) {
+                    ready[c] = false;
+                    changed = true;
+                }
+            }
+        }
     }
-    string line;
-    while (getline(file, line)) {
-        if (line.empty() || line == "[" || line == "]") {
+    vector<PendingCommit> waiting;
+    for (size_t c = 0; c < pending.size(); ++c) {
+        if (!ready[c]) {
+            waiting.push_back(pending[c]);
             continue;
         }
-        if (line.back() == ',') {
-            line.pop_back();
+        for (const auto& account : pending[c].accounts) {
+            store(account.first, account.second);
         }
-        users.push_back(User::fromJson(line));
     }
-    file.close();
-    return users;
+    pending.swap(waiting);
+    ledgerSizes = visible;
 }
-void FileHandler::saveTransaction(const User& user, const string& type, double amount) {
-    auto transactions = loadAllTransactions();
-    string timestamp = getCurrentTimestamp();
-    Transaction newTrans = {timestamp, user.getAccountNumber(), type, amount, user.getBalance()};
-    transactions.push_back(newTrans);
-    saveAllTransactions(transactions);
+Snapshot SnapshotStore::open() {
+    lock_guard<mutex> guard(lock);
+    Snapshot snapshot;
+    snapshot.pages.assign(pages.begin(), pages.end());
+    snapshot.count = count;
+    snapshot.ledgerSizes = ledgerSizes;
+    return snapshot;
 }
-vector<string> FileHandler::loadTransactions(const string& accountNumber) {
-    vector<string> transactions;
-    auto allTransactions = loadAllTransactions();
-    for (const auto& trans : allTransactions) {
-        if (trans.accountNumber == accountNumber) {
-            stringstream formatted;
-            formatted << left << setw(19) << trans.timestamp << "| "
-                     << setw(18) << trans.type << "| $"
-                     << setw(9) << trans.amount << "| $"
-                     << trans.balance;
-            transactions.push_back(formatted.str());
-        }
+BankAggregates::BankAggregates() : totalBalance(), ledgerRecords(0) {
+    fill(typeAccounts, typeAccounts + ACCOUNT_TYPES, 0);
+}
+void BankAggregates::place(size_t index, const User& user) {
+    int type = static_cast<int>(user.getAccountTypeCode());
+    balances[index] = user.getBalance();
+    types[index] = user.getAccountTypeCode();
+    placed[index] = 1;
+    totalBalance += user.getBalance();
+    typeBalances[type] += user.getBalance();
+    typeAccounts[type]++;
+    ranking.insert(make_pair(user.getBalance(), index));
+}
+void BankAggregates::reset(const vector<User>& users) {
+    lock_guard<mutex> guard(lock);
+    balances.assign(users.size(), Money());
+    types.assign(users.size(), AccountType::Savings);
+    placed.assign(users.size(), 0);
+    ranking.clear();
+    totalBalance = Money();
+    fill(typeBalances, typeBalances + ACCOUNT_TYPES, Money());
+    fill(typeAccounts, typeAccounts + ACCOUNT_TYPES, 0);
+    daily.clear();
+    ledgerRecords = 0;
+    for (size_t i = 0; i < users.size(); ++i) {
+        place(i, users[i]);
     }
-    return transactions;
+}
+void BankAggregates::updateAccount(size_t index, const User& user) {
+    lock_guard<mutex> guard(lock);
+    if (index >= balances.size()) {
+        balances.resize(index + 1, Money());
+        types.resize(index + 1, AccountType::Savings);
+        placed.resize(index + 1, 0);
+    }
+    // Accounts opened concurrently can publish out of order, leaving gaps that were never counted.
+    if (placed[index]) {
+        int type = static_cast<int>(types[index]);
+        totalBalance -= balances[index];
+        typeBalances[type] -= balances[index];
+        typeAccounts[type]--;
+        ranking.erase(make_pair(balances[index], index));
+    }
+    place(index, user);
+}
+string BankAggregates::dayOf(const string& timestamp) {
+    time_t when = FileHandler::parseTimestamp(timestamp);
+    return when < 0 ? "unknown" : FileHandler::formatTimestamp(when).substr(0, 10);
+}
+void BankAggregates::recordTransaction(const Transaction& trans) {
+    string day = dayOf(trans.timestamp);
+    lock_guard<mutex> guard(lock);
+    VolumeBucket& bucket = daily[day][trans.kind()];
+    bucket.count++;
+    bucket.amount += trans.amount;
+    ledgerRecords++;
+}
+void BankAggregates::restoreVolumes(const AggregateSummary& saved) {
+    lock_guard<mutex> guard(lock);
+    daily = saved.daily;
+    ledgerRecords = saved.ledgerRecords;
+}
+AggregateSummary BankAggregates::summary(size_t topCount, const deque<User>& users) const {
+    lock_guard<mutex> guard(lock);
+    AggregateSummary result;
+    result.ledgerRecords = ledgerRecords;
+    result.accounts = count(placed.begin(), placed.end(), 1);
+    result.totalBalance = totalBalance;
+    for (int type = 0; type < ACCOUNT_TYPES; ++type) {
+        const char* name = User::accountTypeName(static_cast<AccountType>(type));
+        result.typeBalances[name] = typeBalances[type];
+        result.typeAccounts[name] = typeAccounts[type];
+    }
+    for (auto it = ranking.rbegin(); it != ranking.rend() && result.topAccounts.size() < topCount; ++it) {
+        result.topAccounts.push_back(make_pair(users[it->second].getAccountNumber(), it->first));
+    }
+    result.daily = daily;
+    return result;
 }
 BankingSystem::BankingSystem() : currentUser(nullptr) {
     loadAllData();
@@ -488,11 +3230,9 @@ void BankingSystem::registerUser() {
     cout << "\n=== REGISTER NEW ACCOUNT ===\n";
     cout << "Enter username: ";
     getline(cin, username);
-    for (const auto& user : users) {
-        if (user.getUsername() == username) {
-            cout << "Username already exists! Please choose another.\n";
-            return;
-        }
+    if (usernameIndex.count(username)) {
+        cout << "Username already exists! Please choose another.\n";
+        return;
     }
     cout << "Enter password: ";
     getline(cin, password);
@@ -519,11 +3259,13 @@ void BankingSystem::registerUser() {
             accountType = "Savings";
             cout << "Invalid choice. Setting to Savings Account.\n";
     }
-    User newUser(username, password, name, accountType);
-    users.push_back(newUser);
-    FileHandler::saveUser(newUser);
+    User* newUser = openAccount(username, password, name, accountType);
+    if (!newUser) {
+        cout << "Username already exists! Please choose another.\n";
+        return;
+    }
     cout << "\n Account created successfully!\n";
-    cout << "Account Number: " << newUser.getAccountNumber() << "\n";
+    cout << "Account Number: " << newUser->getAccountNumber() << "\n";
     cout << "Account Type: " << accountType << "\n";
 }
 bool BankingSystem::login() {
@@ -533,12 +3275,11 @@ bool BankingSystem::login() {
     getline(cin, username);
     cout << "Enter password: ";
     getline(cin, password);
-    for (auto& user : users) {
-        if (user.getUsername() == username && user.checkPassword(password)) {
-            currentUser = &user;
-            cout << "\n Login successful! Welcome " << user.getName() << "!\n";
-            return true;
-        }
+    User* user = authenticate(username, password);
+    if (user) {
+        currentUser = user;
+        cout << "\n Login successful! Welcome " << user->getName() << "!\n";
+        return true;
     }
     cout << " Invalid username or password!\n";
     return false;
@@ -550,13 +3291,12 @@ void BankingSystem::atmLogin() {
     getline(cin, cardNumber);
     cout << "Enter 4-digit PIN: ";
     getline(cin, pin);
-    for (auto& user : users) {
-        if (user.getHasCard() && user.getCardNumber() == cardNumber && user.checkCardPin(pin)) {
-            currentUser = &user;
-            cout << "\n ATM Login successful! Welcome " << user.getName() << "!\n";
-            atmDashboard(); 
-            return;
-        }
+    User* user = authenticateCard(cardNumber, pin);
+    if (user) {
+        currentUser = user;
+        cout << "\n ATM Login successful! Welcome " << user->getName() << "!\n";
+        atmDashboard(); 
+        return;
     }
     cout << " Invalid card number or PIN!\n";
 }
@@ -596,46 +3336,41 @@ void BankingSystem::atmDashboard() {
 }
 void BankingSystem::atmWithdraw() {
     if (!currentUser) return;
-    double amount;
+    string input;
+    Money amount;
     cout << "\n=== ATM WITHDRAWAL ===\n";
     cout << "Enter amount to withdraw: $";
-    cin >> amount;
-    if (amount <= 0) {
+    cin >> input;
+    if (!Money::parse(input, amount) || amount <= Money()) {
         cout << "Invalid amount!\n";
         return;
     }
-    if (amount > 1000) {
-        cout << "ATM withdrawal limit is $1000 per transaction.\n";
-        return;
-    }
-    if (currentUser->withdraw(amount)) {
+    string error = atmTransaction(*currentUser, "ATM_WITHDRAWAL", amount);
+    if (error.empty()) {
         cout << "\n Please take your cash: $" << amount << "\n";
         cout << "Available balance: $" << currentUser->getBalance() << "\n";
-        FileHandler::saveTransaction(*currentUser, "ATM_WITHDRAWAL", amount);
-        FileHandler::saveUser(*currentUser);
     } else {
-        cout << "\n Insufficient balance or invalid amount!\n";
+        cout << "\n " << error << "\n";
     }
 }
 void BankingSystem::atmDeposit() {
     if (!currentUser) return;
-    double amount;
+    string input;
+    Money amount;
     cout << "\n=== ATM DEPOSIT ===\n";
     cout << "Enter amount to deposit: $";
-    cin >> amount;
-    if (amount <= 0) {
+    cin >> input;
+    if (!Money::parse(input, amount) || amount <= Money()) {
         cout << "Invalid amount!\n";
         return;
     }
-    if (amount > 5000) {
-        cout << "ATM deposit limit is $5000 per transaction.\n";
-        return;
+    string error = atmTransaction(*currentUser, "ATM_DEPOSIT", amount);
+    if (error.empty()) {
+        cout << "\n Successfully deposited: $" << amount << "\n";
+        cout << "Available balance: $" << currentUser->getBalance() << "\n";
+    } else {
+        cout << "\n " << error << "\n";
     }
-    currentUser->deposit(amount);
-    cout << "\n Successfully deposited: $" << amount << "\n";
-    cout << "Available balance: $" << currentUser->getBalance() << "\n";
-    FileHandler::saveTransaction(*currentUser, "ATM_DEPOSIT", amount);
-    FileHandler::saveUser(*currentUser);
 }
 void BankingSystem::userDashboard() {
     int choice;
@@ -688,75 +3423,323 @@ void BankingSystem::showUserMenu() {
 }
 void BankingSystem::deposit() {
     if (!currentUser) return;
-    double amount;
+    string input;
+    Money amount;
     cout << "\n=== DEPOSIT MONEY ===\n";
     cout << "Enter amount to deposit: $";
-    cin >> amount;
-    if (amount <= 0) {
+    cin >> input;
+    if (!Money::parse(input, amount) || amount <= Money()) {
         cout << "Invalid amount!\n";
         return;
     }
-    currentUser->deposit(amount);
-    cout << "\n Successfully deposited: $" << amount << "\n";
-    cout << "Available balance: $" << currentUser->getBalance() << "\n";
-    FileHandler::saveTransaction(*currentUser, "DEPOSIT", amount);
-    FileHandler::saveUser(*currentUser);
+    if (depositTo(*currentUser, amount)) {
+        cout << "\n Successfully deposited: $" << amount << "\n";
+        cout << "Available balance: $" << currentUser->getBalance() << "\n";
+    } else {
+        cout << "\n Deposit could not be recorded. Please try again later.\n";
+    }
 }
 void BankingSystem::withdraw() {
     if (!currentUser) return;
-    double amount;
+    string input;
+    Money amount;
     cout << "\n=== WITHDRAW MONEY ===\n";
     cout << "Enter amount to withdraw: $";
-    cin >> amount;
-    if (amount <= 0) {
+    cin >> input;
+    if (!Money::parse(input, amount) || amount <= Money()) {
         cout << "Invalid amount!\n";
         return;
     }
-    if (currentUser->withdraw(amount)) {
+    if (withdrawFrom(*currentUser, amount)) {
         cout << "\n Successfully withdrawn: $" << amount << "\n";
         cout << "Available balance: $" << currentUser->getBalance() << "\n";
-        FileHandler::saveTransaction(*currentUser, "WITHDRAW", amount);
-        FileHandler::saveUser(*currentUser);
-    } else {
+    } else if (currentUser->getBalance() < amount) {
         cout << "\n Insufficient balance!\n";
+    } else {
+        cout << "\n Withdrawal could not be recorded. Please try again later.\n";
     }
 }
 void BankingSystem::transfer() {
     if (!currentUser) return;
     string targetAccount;
-    double amount;
+    string input;
+    Money amount;
     cout << "\n=== TRANSFER MONEY ===\n";
     cout << "Enter target account number: ";
     cin >> targetAccount;
     cout << "Enter amount to transfer: $";
-    cin >> amount;
-    if (amount <= 0) {
+    cin >> input;
+    if (!Money::parse(input, amount) || amount <= Money()) {
         cout << "Invalid amount!\n";
         return;
     }
-    if (!currentUser->withdraw(amount)) {
-        cout << "Insufficient balance!\n";
-        return;
+    string error = transferFunds(*currentUser, targetAccount, amount);
+    if (error.empty()) {
+        cout << "\n Successfully transferred $" << amount << " to account " << targetAccount << "\n";
+    } else {
+        cout << "\n " << error << "\n";
+    }
+}
+size_t BankingSystem::indexOf(const User* user) const {
+    shared_lock<shared_mutex> guard(registryLock);
+    return accountIndex.at(user->getAccountNumber());
+}
+mutex& BankingSystem::lockFor(const User* user) {
+    return accountLocks[indexOf(user) % ACCOUNT_LOCKS];
+}
+bool BankingSystem::commitUser(User& user, const string& type, Money amount) {
+    Transaction trans = FileHandler::makeTransaction(user, type, amount);
+    LedgerPosition row = FileHandler::saveTransaction(trans);
+    if (row.shard < 0) {
+        return false;
+    }
+    FileHandler::saveUser(user);
+    aggregates.recordTransaction(trans);
+    publish({&user}, {row});
+    return true;
+}
+User* BankingSystem::openAccount(const string& username, const string& password, const string& name, const string& accountType) {
+    User* created;
+    {
+        unique_lock<shared_mutex> guard(registryLock);
+        if (usernameIndex.count(username)) {
+            return nullptr;
+        }
+        users.push_back(User(username, password, name, accountType));
+        created = &users.back();
+        accountIndex[created->getAccountNumber()] = users.size() - 1;
+        usernameIndex[username] = users.size() - 1;
+    }
+    User& user = *created;
+    FileHandler::saveUser(user);
+    publish({&user}, {});
+    return &user;
+}
+User* BankingSystem::authenticate(const string& username, const string& password) {
+    shared_lock<shared_mutex> guard(registryLock);
+    auto it = usernameIndex.find(username);
+    if (it == usernameIndex.end() || !users[it->second].checkPassword(password)) {
+        return nullptr;
+    }
+    return &users[it->second];
+}
+User* BankingSystem::authenticateCard(const string& cardNumber, const string& pin) {
+    shared_lock<shared_mutex> guard(registryLock);
+    auto it = cardIndex.find(User::parseCardNumber(cardNumber));
+    if (it == cardIndex.end() || !users[it->second].checkCardPin(pin)) {
+        return nullptr;
+    }
+    return &users[it->second];
+}
+bool BankingSystem::depositTo(User& user, Money amount) {
+    if (amount <= Money()) {
+        return false;
+    }
+    lock_guard<mutex> guard(lockFor(&user));
+    user.deposit(amount);
+    if (!commitUser(user, "DEPOSIT", amount)) {
+        user.withdraw(amount);
+        return false;
+    }
+    return true;
+}
+bool BankingSystem::withdrawFrom(User& user, Money amount) {
+    lock_guard<mutex> guard(lockFor(&user));
+    if (!user.withdraw(amount)) {
+        return false;
+    }
+    if (!commitUser(user, "WITHDRAW", amount)) {
+        user.deposit(amount);
+        return false;
+    }
+    return true;
+}
+string BankingSystem::atmTransaction(User& user, const string& type, Money amount) {
+    lock_guard<mutex> guard(lockFor(&user));
+    time_t now = time(nullptr);
+    string limitReason = atmLimiter.check(user.getAccountNumber(), user.getCardNumber(), type, amount, now);
+    if (!limitReason.empty()) {
+        return limitReason;
+    }
+    if (type == "ATM_WITHDRAWAL") {
+        if (!user.withdraw(amount)) {
+            return "Insufficient balance or invalid amount!";
+        }
+    } else {
+        user.deposit(amount);
     }
-    for (auto& user : users) {
-        if (user.getAccountNumber() == targetAccount && &user != currentUser) {
+    if (!commitUser(user, type, amount)) {
+        if (type == "ATM_WITHDRAWAL") {
             user.deposit(amount);
-            FileHandler::saveUser(user);
-            cout << "\n Successfully transferred $" << amount << " to account " << targetAccount << "\n";
-            FileHandler::saveTransaction(*currentUser, "TRANSFER_OUT:" + targetAccount, amount);
-            FileHandler::saveTransaction(user, "TRANSFER_IN:" + currentUser->getAccountNumber(), amount);
-            FileHandler::saveUser(*currentUser);
-            return;
+        } else {
+            user.withdraw(amount);
+        }
+        return "Transaction could not be recorded. Please try again later.";
+    }
+    atmLimiter.record(user.getAccountNumber(), user.getCardNumber(), type, amount, now);
+    return "";
+}
+string BankingSystem::transferFunds(User& from, const string& targetAccount, Money amount) {
+    User* target = findAccount(targetAccount);
+    if (!target || target == &from) {
+        return "Target account not found!";
+    }
+    mutex& first = lockFor(&from);
+    mutex& second = lockFor(target);
+    unique_lock<mutex> firstGuard(&first < &second ? first : second);
+    unique_lock<mutex> secondGuard;
+    if (&first != &second) {
+        secondGuard = unique_lock<mutex>(&first < &second ? second : first);
+    }
+    if (!from.withdraw(amount)) {
+        return "Insufficient balance!";
+    }
+    target->deposit(amount);
+    vector<Transaction> transactions = {
+        FileHandler::makeTransaction(from, "TRANSFER_OUT:" + targetAccount, amount),
+        FileHandler::makeTransaction(*target, "TRANSFER_IN:" + from.getAccountNumber(), amount)
+    };
+    vector<LedgerPosition> rows;
+    if (!FileHandler::commitBatch({from, *target}, transactions, rows)) {
+        target->withdraw(amount);
+        from.deposit(amount);
+        return "Transfer could not be recorded. Please try again later.";
+    }
+    for (const auto& trans : transactions) {
+        aggregates.recordTransaction(trans);
+    }
+    publish({&from, target}, rows);
+    return "";
+}
+string BankingSystem::issueCard(User& user) {
+    lock_guard<mutex> guard(lockFor(&user));
+    string pin = user.issueCard();
+    if (!pin.empty()) {
+        size_t index = indexOf(&user);
+        {
+            unique_lock<shared_mutex> registryGuard(registryLock);
+            cardIndex[user.getCardDigits()] = index;
+        }
+        FileHandler::saveUser(user);
+        publish({&user}, {});
+    }
+    return pin;
+}
+void BankingSystem::publish(const vector<const User*>& touched, const vector<LedgerPosition>& rows) {
+    vector<pair<size_t, User>> accounts;
+    for (const User* user : touched) {
+        size_t index = indexOf(user);
+        accounts.push_back(make_pair(index, *user));
+        aggregates.updateAccount(index, *user);
+    }
+    snapshots.publish(accounts, rows);
+}
+AggregateSummary BankingSystem::getAggregates(size_t topCount) const {
+    shared_lock<shared_mutex> guard(registryLock);
+    return aggregates.summary(topCount, users);
+}
+Snapshot BankingSystem::openSnapshot() {
+    return snapshots.open();
+}
+User* BankingSystem::findAccount(const string& accountNumber) {
+    shared_lock<shared_mutex> guard(registryLock);
+    auto it = accountIndex.find(accountNumber);
+    return it == accountIndex.end() ? nullptr : &users[it->second];
+}
+BatchResult BankingSystem::batchTransfer(const vector<TransferRequest>& requests) {
+    BatchResult result = {false, {}};
+    if (requests.empty()) {
+        result.errors.push_back("Batch contains no transfers.");
+        return result;
+    }
+    vector<size_t> order(requests.size());
+    vector<size_t> from(requests.size()), to(requests.size());
+    unordered_map<size_t, User*> accounts;
+    shared_lock<shared_mutex> registryGuard(registryLock);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        order[i] = i;
+        const TransferRequest& request = requests[i];
+        stringstream error;
+        auto fromIt = accountIndex.find(request.fromAccount);
+        auto toIt = accountIndex.find(request.toAccount);
+        if (request.amount <= Money()) {
+            error << "Item " << i + 1 << ": invalid amount.";
+        } else if (fromIt == accountIndex.end()) {
+            error << "Item " << i + 1 << ": source account " << request.fromAccount << " not found.";
+        } else if (toIt == accountIndex.end()) {
+            error << "Item " << i + 1 << ": target account " << request.toAccount << " not found.";
+        } else if (fromIt->second == toIt->second) {
+            error << "Item " << i + 1 << ": source and target are the same account.";
+        } else {
+            from[i] = fromIt->second;
+            to[i] = toIt->second;
+            accounts[from[i]] = &users[from[i]];
+            accounts[to[i]] = &users[to[i]];
+            continue;
+        }
+        result.errors.push_back(error.str());
+    }
+    registryGuard.unlock();
+    if (!result.errors.empty()) {
+        return result;
+    }
+    vector<unique_lock<mutex>> guards;
+    for (auto& accountLock : accountLocks) {
+        guards.emplace_back(accountLock);
+    }
+    stable_sort(order.begin(), order.end(), [&from, &to](size_t a, size_t b) {
+        return from[a] != from[b] ? from[a] < from[b] : to[a] < to[b];
+    });
+    string timestamp = FileHandler::getCurrentTimestamp();
+    unordered_map<size_t, User> updated;
+    vector<Transaction> transactions;
+    transactions.reserve(requests.size() * 2);
+    for (size_t i : order) {
+        User& source = updated.emplace(from[i], *accounts[from[i]]).first->second;
+        User& target = updated.emplace(to[i], *accounts[to[i]]).first->second;
+        Money amount = requests[i].amount;
+        if (!source.withdraw(amount)) {
+            stringstream error;
+            error << "Item " << i + 1 << ": insufficient balance in " << requests[i].fromAccount << ".";
+            result.errors.push_back(error.str());
+            continue;
         }
+        target.deposit(amount);
+        transactions.push_back({timestamp, source.getAccountNumber(), "TRANSFER_OUT:" + target.getAccountNumber(),
+                                amount, source.getBalance(), ""});
+        transactions.push_back({timestamp, target.getAccountNumber(), "TRANSFER_IN:" + source.getAccountNumber(),
+                                amount, target.getBalance(), ""});
+    }
+    if (!result.errors.empty()) {
+        return result;
+    }
+    vector<User> touched;
+    touched.reserve(updated.size());
+    for (const auto& entry : updated) {
+        touched.push_back(entry.second);
+    }
+    vector<LedgerPosition> rows;
+    if (!FileHandler::commitBatch(touched, transactions, rows)) {
+        result.errors.push_back("Batch could not be recorded; no transfers were applied.");
+        return result;
     }
-    currentUser->deposit(amount);
-    cout << "\n Target account not found!\n";
+    vector<const User*> published;
+    for (const auto& entry : updated) {
+        *accounts[entry.first] = entry.second;
+        published.push_back(accounts[entry.first]);
+    }
+    for (const auto& trans : transactions) {
+        aggregates.recordTransaction(trans);
+    }
+    publish(published, rows);
+    result.applied = true;
+    return result;
 }
 void BankingSystem::showBalance() {
     if (!currentUser) return;
     cout << "\n=== ACCOUNT BALANCE ===\n";
     cout << "Account: " << currentUser->getAccountNumber() << "\n";
-    cout << "Balance: $" << fixed << setprecision(2) << currentUser->getBalance() << "\n";
+    cout << "Balance: $" << currentUser->getBalance() << "\n";
 }
 void BankingSystem::showAccountInfo() {
     if (!currentUser) return;
@@ -764,7 +3747,7 @@ void BankingSystem::showAccountInfo() {
     cout << "Account Number: " << currentUser->getAccountNumber() << "\n";
     cout << "Account Holder: " << currentUser->getName() << "\n";
     cout << "Account Type: " << currentUser->getAccountType() << "\n";
-    cout << "Balance: $" << fixed << setprecision(2) << currentUser->getBalance() << "\n";
+    cout << "Balance: $" << currentUser->getBalance() << "\n";
     if (currentUser->getHasCard()) {
         cout << "ATM Card: " << currentUser->getCardNumber() << "\n";
         cout << "Note: PIN is hidden for security\n";
@@ -824,8 +3807,14 @@ void BankingSystem::manageATMCard() {
 }
 void BankingSystem::requestNewCard() {
     if (!currentUser) return;
-    currentUser->requestATMCard();
-    FileHandler::saveUser(*currentUser);
+    string pin = issueCard(*currentUser);
+    if (!pin.empty()) {
+        cout << "\nATM Card issued successfully!\n";
+        cout << "Card Number: " << currentUser->getCardNumber() << "\n";
+        cout << "PIN: " << pin << " (Keep this safe!)\n";
+    } else {
+        cout << "\nYou already have an ATM card.\n";
+    }
 }
 void BankingSystem::changeCardPin() {
     if (!currentUser) return;
@@ -854,24 +3843,515 @@ void BankingSystem::changeCardPin() {
         cout << "\n PINs don't match!\n";
         return;
     }
+    lock_guard<mutex> guard(lockFor(currentUser));
     currentUser->changeCardPin(newPin);
     FileHandler::saveUser(*currentUser);
+    publish({currentUser}, {});
+}
+LoadConfig::LoadConfig()
+    : accounts(2000), threads(4), operations(20000), zipfExponent(1.1), shards(4),
+      burstOperations(50), idleMillis(2) {
+    int defaults[LOAD_OPERATION_COUNT] = {10, 5, 20, 15, 15, 5, 20, 10};
+    copy(defaults, defaults + LOAD_OPERATION_COUNT, mix);
+}
+bool LoadConfig::set(const string& option) {
+    size_t eq = option.find('=');
+    if (eq == string::npos) {
+        return false;
+    }
+    string key = option.substr(0, eq);
+    string value = option.substr(eq + 1);
+    if (key == "accounts") accounts = max(2L, atol(value.c_str()));
+    else if (key == "threads") threads = max(1, atoi(value.c_str()));
+    else if (key == "ops") operations = max(1L, atol(value.c_str()));
+    else if (key == "zipf") zipfExponent = atof(value.c_str());
+    else if (key == "shards") shards = max(1, atoi(value.c_str()));
+    else if (key == "burst") burstOperations = max(1.0, atof(value.c_str()));
+    else if (key == "idle") idleMillis = max(0.0, atof(value.c_str()));
+    else if (key == "mix") {
+        fill(mix, mix + LOAD_OPERATION_COUNT, 0);
+        stringstream entries(value);
+        string entry;
+        while (getline(entries, entry, ',')) {
+            size_t colon = entry.find(':');
+            for (int i = 0; i < LOAD_OPERATION_COUNT; ++i) {
+                if (entry.substr(0, colon) == LoadGenerator::operationName(i)) {
+                    mix[i] = colon == string::npos ? 1 : atoi(entry.substr(colon + 1).c_str());
+                }
+            }
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+const char* LoadGenerator::operationName(int operation) {
+    static const char* names[LOAD_OPERATION_COUNT] = {
+        "login", "atm_login", "deposit", "withdraw", "atm_withdraw", "atm_deposit", "transfer", "history"
+    };
+    return names[operation];
+}
+LoadGenerator::LoadGenerator(const LoadConfig& config) : config(config) {
+}
+void LoadGenerator::createAccounts() {
+    const char* types[] = {"Savings", "Current", "Fixed"};
+    accounts.reserve(config.accounts);
+    for (long i = 0; i < config.accounts; ++i) {
+        Account account;
+        account.username = "load" + to_string(i);
+        account.password = "pw" + to_string(i);
+        account.user = bank->openAccount(account.username, account.password, "Load Client " + to_string(i), types[i % 3]);
+        bank->depositTo(*account.user, Money::fromDollars(1000));
+        account.pin = bank->issueCard(*account.user);
+        account.accountNumber = account.user->getAccountNumber();
+        account.cardNumber = account.user->getCardNumber();
+        accounts.push_back(account);
+    }
+    for (auto& account : accounts) {
+        account.user = bank->findAccount(account.accountNumber);
+    }
+    popularity.resize(accounts.size());
+    double total = 0.0;
+    for (size_t rank = 0; rank < accounts.size(); ++rank) {
+        total += 1.0 / pow(static_cast<double>(rank + 1), config.zipfExponent);
+        popularity[rank] = total;
+    }
+    for (auto& weight : popularity) {
+        weight /= total;
+    }
+    shuffle(accounts.begin(), accounts.end(), mt19937_64(7));
+}
+size_t LoadGenerator::pickAccount(mt19937_64& gen) const {
+    double u = uniform_real_distribution<double>(0.0, 1.0)(gen);
+    size_t rank = lower_bound(popularity.begin(), popularity.end(), u) - popularity.begin();
+    return min(rank, accounts.size() - 1);
+}
+bool LoadGenerator::execute(int operation, mt19937_64& gen) {
+    Account& account = accounts[pickAccount(gen)];
+    uniform_int_distribution<int> dollars(1, 200);
+    switch (operation) {
+        case LOAD_LOGIN:
+            return bank->authenticate(account.username, account.password) != nullptr;
+        case LOAD_ATM_LOGIN:
+            return bank->authenticateCard(account.cardNumber, account.pin) != nullptr;
+        case LOAD_DEPOSIT:
+            return bank->depositTo(*account.user, Money::fromDollars(dollars(gen)));
+        case LOAD_WITHDRAW:
+            return bank->withdrawFrom(*account.user, Money::fromDollars(dollars(gen) / 2));
+        case LOAD_ATM_WITHDRAW:
+            return bank->atmTransaction(*account.user, "ATM_WITHDRAWAL", Money::fromDollars(20 * (dollars(gen) % 5 + 1))).empty();
+        case LOAD_ATM_DEPOSIT:
+            return bank->atmTransaction(*account.user, "ATM_DEPOSIT", Money::fromDollars(dollars(gen))).empty();
+        case LOAD_TRANSFER: {
+            const Account& target = accounts[pickAccount(gen)];
+            if (&target == &account) {
+                return false;
+            }
+            return bank->transferFunds(*account.user, target.accountNumber, Money::fromDollars(dollars(gen) / 4)).empty();
+        }
+        default:
+            FileHandler::loadTransactions(account.accountNumber);
+            return true;
+    }
+}
+void LoadGenerator::runClient(int client, ClientStats& stats) {
+    mt19937_64 gen(1000 + client);
+    discrete_distribution<int> operations(config.mix, config.mix + LOAD_OPERATION_COUNT);
+    exponential_distribution<double> burstLength(1.0 / config.burstOperations);
+    exponential_distribution<double> idle(config.idleMillis > 0 ? 1.0 / config.idleMillis : 1.0);
+    long quota = config.operations / config.threads + (client < config.operations % config.threads ? 1 : 0);
+    long burst = static_cast<long>(burstLength(gen)) + 1;
+    fill(stats.rejected, stats.rejected + LOAD_OPERATION_COUNT, 0);
+    for (long i = 0; i < quota; ++i) {
+        if (--burst == 0) {
+            if (config.idleMillis > 0) {
+                this_thread::sleep_for(chrono::duration<double, milli>(idle(gen)));
+            }
+            burst = static_cast<long>(burstLength(gen)) + 1;
+        }
+        int operation = operations(gen);
+        auto start = chrono::steady_clock::now();
+        bool accepted = execute(operation, gen);
+        stats.latencies[operation].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        if (!accepted) {
+            stats.rejected[operation]++;
+        }
+    }
+}
+void LoadGenerator::report(const vector<ClientStats>& stats, double seconds) const {
+    long total = 0;
+    cout << "\n=== LOAD GENERATOR RESULTS ===\n";
+    cout << "Accounts: " << config.accounts << "  Threads: " << config.threads << "  Shards: " << config.shards
+         << "  Zipf: " << config.zipfExponent << "\n";
+    cout << left << setw(14) << "Operation" << right << setw(9) << "Count" << setw(10) << "Rejected"
+         << setw(12) << "p50 (us)" << setw(12) << "p99 (us)" << setw(12) << "p999 (us)" << "\n";
+    cout << fixed << setprecision(1);
+    for (int op = 0; op < LOAD_OPERATION_COUNT; ++op) {
+        vector<double> latencies;
+        long rejected = 0;
+        for (const auto& client : stats) {
+            latencies.insert(latencies.end(), client.latencies[op].begin(), client.latencies[op].end());
+            rejected += client.rejected[op];
+        }
+        if (latencies.empty()) {
+            continue;
+        }
+        sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double q) {
+            return latencies[min(latencies.size() - 1, static_cast<size_t>(q * latencies.size()))];
+        };
+        total += latencies.size();
+        cout << left << setw(14) << operationName(op) << right << setw(9) << latencies.size() << setw(10) << rejected
+             << setw(12) << percentile(0.50) << setw(12) << percentile(0.99) << setw(12) << percentile(0.999) << "\n";
+    }
+    cout << "Elapsed: " << setprecision(3) << seconds << " s  Throughput: " << setprecision(1)
+         << total / seconds << " ops/s\n";
+}
+void LoadGenerator::run() {
+    const string directory = "loadgen_data";
+    filesystem::remove_all(directory);
+    filesystem::create_directories(directory);
+    ofstream shardConfig(directory + "/shards.cfg");
+    shardConfig << config.shards << "\n";
+    shardConfig.close();
+    FileHandler::setDataDirectory(directory);
+    bank.reset(new BankingSystem());
+    cout << "Creating " << config.accounts << " accounts...\n";
+    createAccounts();
+    vector<ClientStats> stats(config.threads);
+    vector<thread> clients;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < config.threads; ++i) {
+        clients.emplace_back(&LoadGenerator::runClient, this, i, ref(stats[i]));
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    report(stats, seconds);
+    bank.reset();
+    FileHandler::setDataDirectory("data");
+    filesystem::remove_all(directory);
 }
 void BankingSystem::logout() {
     currentUser = nullptr;
     cout << "\n Successfully logged out.\n";
 }
 void BankingSystem::saveAllData() {
-    FileHandler::saveAllUsers(users);
+    shared_lock<shared_mutex> guard(registryLock);
+    FileHandler::saveAllUsers(vector<User>(users.begin(), users.end()));
+    FileHandler::saveAggregates(aggregates.summary(AGGREGATE_TOP_ACCOUNTS, users));
 }
 void BankingSystem::loadAllData() {
-    users = FileHandler::loadAllUsers();
+    FileHandler::recoverJournal();
+    vector<User> loaded = FileHandler::loadAllUsers();
+    unique_lock<shared_mutex> registryGuard(registryLock);
+    users.assign(loaded.begin(), loaded.end());
+    accountIndex.clear();
+    usernameIndex.clear();
+    cardIndex.clear();
+    for (size_t i = 0; i < users.size(); ++i) {
+        accountIndex[users[i].getAccountNumber()] = i;
+        usernameIndex.emplace(string(users[i].getUsername()), i);
+        if (users[i].getHasCard()) {
+            cardIndex[users[i].getCardDigits()] = i;
+        }
+    }
+    registryGuard.unlock();
+    snapshots.reset(loaded);
+    aggregates.reset(loaded);
+    vector<size_t> ledgerSizes = FileHandler::getLedgerSizes();
+    size_t ledgerRecords = 0;
+    for (size_t size : ledgerSizes) {
+        ledgerRecords += size;
+    }
+    AggregateSummary saved;
+    if (FileHandler::loadAggregates(saved) && saved.ledgerRecords == ledgerRecords) {
+        aggregates.restoreVolumes(saved);
+    } else {
+        for (size_t shard = 0; shard < ledgerSizes.size(); ++shard) {
+            for (const auto& trans : FileHandler::loadLedgerShard(static_cast<int>(shard))) {
+                aggregates.recordTransaction(trans);
+            }
+        }
+    }
+    atmLimiter.configure(ATMLimits::load(FileHandler::dataPath(ATM_LIMITS_FILE)));
+    atmLimiter.rebuild(loaded, FileHandler::loadAllTransactions(), time(nullptr));
 }
 void setColor(int color) {
     HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
     SetConsoleTextAttribute(hConsole, color);
 }
-int main() {
+void auditLedger() {
+    FileHandler::recoverJournal();
+    auto start = chrono::steady_clock::now();
+    LedgerAudit audit = FileHandler::verifyLedger(false);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Verified " << audit.records << " record(s) in " << audit.segments << " segment(s) against "
+         << audit.checkpoints << " signed checkpoint(s) in " << fixed << setprecision(2) << seconds << "s.\n";
+    if (audit.unsealed > 0) {
+        cout << audit.unsealed << " record(s) are not covered by a signed head; review them, then run --seal-ledger.\n";
+    }
+    if (audit.failures.empty()) {
+        cout << "Ledger intact.\n";
+        return;
+    }
+    cout << "LEDGER TAMPERING DETECTED:\n";
+    const size_t shown = 20;
+    for (size_t i = 0; i < audit.failures.size() && i < shown; ++i) {
+        cout << "  " << audit.failures[i] << "\n";
+    }
+    if (audit.failures.size() > shown) {
+        cout << "  ... and " << audit.failures.size() - shown << " more\n";
+    }
+}
+void sealUnsealedLedger() {
+    FileHandler::recoverJournal();
+    LedgerAudit audit = FileHandler::verifyLedger(true);
+    if (!audit.failures.empty()) {
+        cout << "Ledger not sealed; the signed part failed verification:\n";
+        for (size_t i = 0; i < audit.failures.size() && i < 20; ++i) {
+            cout << "  " << audit.failures[i] << "\n";
+        }
+        return;
+    }
+    if (audit.unsealed == 0) {
+        cout << "Ledger already sealed.\n";
+        return;
+    }
+    if (FileHandler::adoptUnsealedRecords()) {
+        cout << "Sealed " << audit.unsealed << " record(s).\n";
+    } else {
+        cout << "Some shards could not be sealed.\n";
+    }
+}
+void archiveLedger(const string& cutoffDate) {
+    time_t cutoff = FileHandler::parseTimestamp(cutoffDate + " 00:00:00");
+    if (cutoff < 0) {
+        cout << "Invalid cutoff date. Use YYYY-MM-DD.\n";
+        return;
+    }
+    FileHandler::recoverJournal();
+    auto start = chrono::steady_clock::now();
+    size_t hotRecords = FileHandler::loadAllTransactions().size();
+    double jsonSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    ArchiveStats stats = FileHandler::archiveTransactions(cutoff);
+    size_t archivedRecords = 0;
+    start = chrono::steady_clock::now();
+    FileHandler::scanArchives([&archivedRecords](const Transaction&) {
+        archivedRecords++;
+    });
+    double archiveSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Archived " << stats.records << " transaction(s) older than " << cutoffDate << ".\n";
+    cout << fixed << setprecision(2);
+    if (stats.archiveBytes > 0) {
+        cout << "JSON size:    " << stats.jsonBytes << " bytes\n";
+        cout << "Archive size: " << stats.archiveBytes << " bytes (" << static_cast<double>(stats.jsonBytes) / stats.archiveBytes << "x smaller)\n";
+    }
+    if (jsonSeconds > 0 && archiveSeconds > 0) {
+        cout << "JSON scan:    " << hotRecords / jsonSeconds / 1e6 << " M records/s\n";
+        cout << "Archive scan: " << archivedRecords / archiveSeconds / 1e6 << " M records/s\n";
+    }
+}
+void printAdminReport(const AggregateSummary& summary, size_t topCount) {
+    cout << "\n=== BANK SUMMARY ===\n";
+    cout << "Accounts: " << summary.accounts << "\n";
+    cout << "Ledger records: " << summary.ledgerRecords << "\n";
+    cout << "Total deposits held: $" << summary.totalBalance << "\n";
+    for (const auto& entry : summary.typeBalances) {
+        cout << "  " << left << setw(9) << entry.first << setw(8) << summary.typeAccounts.at(entry.first)
+             << "$" << entry.second << "\n";
+    }
+    cout << "\n=== TOP " << min(topCount, summary.topAccounts.size()) << " ACCOUNTS BY BALANCE ===\n";
+    for (size_t i = 0; i < summary.topAccounts.size() && i < topCount; ++i) {
+        cout << "  " << setw(4) << i + 1 << setw(12) << summary.topAccounts[i].first << "$" << summary.topAccounts[i].second << "\n";
+    }
+    cout << "\n=== DAILY VOLUME ===\n";
+    for (const auto& day : summary.daily) {
+        for (const auto& kind : day.second) {
+            cout << "  " << left << setw(12) << day.first << setw(16) << kind.first << setw(8) << kind.second.count
+                 << "$" << kind.second.amount << "\n";
+        }
+    }
+}
+void printSnapshotReport(const Snapshot& snapshot) {
+    Money totalBalance;
+    map<string, Money> typeBalances;
+    cout << "\n=== BALANCE LISTING ===\n";
+    cout << "Account     | Type     | Balance\n";
+    snapshot.forEachAccount([&](const User& user) {
+        totalBalance += user.getBalance();
+        typeBalances[user.getAccountType()] += user.getBalance();
+        cout << left << setw(12) << user.getAccountNumber() << "| " << setw(9) << user.getAccountType()
+             << "| $" << user.getBalance() << "\n";
+    });
+    map<string, Money> volumes;
+    map<string, size_t> counts;
+    snapshot.forEachTransaction([&](const Transaction& trans) {
+        volumes[trans.kind()] += trans.amount;
+        counts[trans.kind()]++;
+    });
+    cout << "\n=== TOTALS ===\n";
+    cout << "Accounts: " << snapshot.accountCount() << "\n";
+    cout << "Total deposits held: $" << totalBalance << "\n";
+    for (const auto& entry : typeBalances) {
+        cout << "  " << left << setw(9) << entry.first << "$" << entry.second << "\n";
+    }
+    cout << "\n=== LEDGER VOLUME ===\n";
+    for (const auto& entry : volumes) {
+        cout << "  " << left << setw(16) << entry.first << setw(8) << counts[entry.first] << "$" << entry.second << "\n";
+    }
+}
+void benchmarkUserMemory(long count) {
+    const char* firstNames[] = {"Aftab", "Muhammad", "Ayesha", "Fatima", "Ali", "Hassan", "Zainab", "Omar"};
+    const char* lastNames[] = {"Hussain", "Khan", "Ahmed", "Malik", "Qureshi", "Siddiqui", "Chaudhry", "Sheikh"};
+    const char* types[] = {"Savings", "Current", "Fixed"};
+    size_t poolBefore = StringPool::instance().bytesUsed();
+    vector<User> accounts;
+    accounts.reserve(count);
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < count; ++i) {
+        string name = string(firstNames[i % 8]) + " " + lastNames[(i / 8) % 8] + " " + lastNames[(i / 64) % 8];
+        accounts.emplace_back("user" + to_string(i), "pw" + to_string(i % 1000000), name, types[i % 3]);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    size_t poolBytes = StringPool::instance().bytesUsed() - poolBefore;
+    cout << "Accounts:          " << count << "\n";
+    cout << "sizeof(User):      " << sizeof(User) << " bytes\n";
+    cout << "String pool:       " << poolBytes << " bytes\n";
+    cout << "Bytes per account: " << fixed << setprecision(1)
+         << (static_cast<double>(sizeof(User)) * count + poolBytes) / max(count, 1L) << "\n";
+    cout << "Build time:        " << setprecision(3) << seconds << " s\n";
+}
+void benchmarkPayroll(long count) {
+    const string directory = "bench_payroll";
+    filesystem::remove_all(directory);
+    filesystem::create_directories(directory);
+    FileHandler::setDataDirectory(directory);
+    vector<User> accounts;
+    accounts.reserve(count + 1);
+    accounts.emplace_back("employer", "secret", "Payroll Employer", "Current");
+    accounts.back().deposit(Money::fromDollars(count * 5000LL));
+    for (long i = 0; i < count; ++i) {
+        accounts.emplace_back("employee" + to_string(i), "secret", "Employee " + to_string(i), "Savings");
+    }
+    FileHandler::saveAllUsers(accounts);
+    vector<TransferRequest> requests;
+    requests.reserve(count);
+    mt19937 gen(42);
+    uniform_int_distribution<int> salary(2000, 4999);
+    for (long i = count; i > 0; --i) {
+        requests.push_back({accounts[0].getAccountNumber(), accounts[i].getAccountNumber(),
+                            Money::fromDollars(salary(gen))});
+    }
+    {
+        BankingSystem bankingSystem;
+        auto start = chrono::steady_clock::now();
+        BatchResult result = bankingSystem.batchTransfer(requests);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Transfers:        " << count << (result.applied ? "" : " (rejected)") << "\n";
+        cout << "Batch time:       " << fixed << setprecision(3) << seconds << " s\n";
+        cout << "Per transfer:     " << setprecision(2) << seconds * 1e6 / max(count, 1L) << " us\n";
+    }
+    FileHandler::setDataDirectory("data");
+    filesystem::remove_all(directory);
+}
+bool runAdminCommand(int argc, char* argv[]) {
+    if (argc < 2) {
+        return false;
+    }
+    string command = argv[1];
+    if (command == "--rebalance" && argc == 3) {
+        int newCount = atoi(argv[2]);
+        if (newCount <= 0) {
+            cout << "Rebalance failed. Shard count must be a positive number.\n";
+        } else if (FileHandler::rebalanceShards(newCount)) {
+            cout << "Data rebalanced across " << newCount << " shard(s).\n";
+        } else {
+            cout << "Rebalance failed.\n";
+        }
+        return true;
+    }
+    if (command == "--bench-memory" && argc == 3) {
+        benchmarkUserMemory(atol(argv[2]));
+        return true;
+    }
+    if (command == "--payroll" && argc == 3) {
+        vector<TransferRequest> requests;
+        BatchResult result = {false, {}};
+        if (FileHandler::loadTransferBatch(argv[2], requests, result.errors)) {
+            BankingSystem bankingSystem;
+            result = bankingSystem.batchTransfer(requests);
+        }
+        if (result.applied) {
+            cout << "Applied " << requests.size() << " transfer(s).\n";
+        } else {
+            cout << "Batch rejected, nothing was applied:\n";
+            for (const auto& error : result.errors) {
+                cout << "  " << error << "\n";
+            }
+        }
+        return true;
+    }
+    if (command == "--snapshot-report" && argc == 2) {
+        BankingSystem bankingSystem;
+        Snapshot snapshot = bankingSystem.openSnapshot();
+        printSnapshotReport(snapshot);
+        snapshot.release();
+        return true;
+    }
+    if (command == "--admin-report" && argc <= 3) {
+        size_t topCount = argc == 3 ? static_cast<size_t>(max(1, atoi(argv[2]))) : 10;
+        AggregateSummary summary;
+        if (!FileHandler::loadAggregates(summary) || !FileHandler::aggregatesCurrent(summary)) {
+            BankingSystem bankingSystem;
+            summary = bankingSystem.getAggregates(AGGREGATE_TOP_ACCOUNTS);
+        }
+        printAdminReport(summary, topCount);
+        return true;
+    }
+    if (command == "--generate-ledger-key" && argc == 3) {
+        if (FileHandler::generateLedgerKey(argv[2])) {
+            cout << "Ledger key written to " << argv[2] << ". Set BANK_LEDGER_KEY_FILE to this path.\n";
+        }
+        return true;
+    }
+    if (command == "--seal-ledger" && argc == 2) {
+        sealUnsealedLedger();
+        return true;
+    }
+    if (command == "--verify-ledger" && argc == 2) {
+        auditLedger();
+        return true;
+    }
+    if (command == "--archive" && argc == 3) {
+        archiveLedger(argv[2]);
+        return true;
+    }
+    if (command == "--loadgen") {
+        LoadConfig config;
+        for (int i = 2; i < argc; ++i) {
+            if (!config.set(argv[i])) {
+                cout << "Unknown load generator option: " << argv[i] << "\n";
+                return true;
+            }
+        }
+        LoadGenerator(config).run();
+        return true;
+    }
+    if (command == "--bench-payroll" && argc == 3) {
+        benchmarkPayroll(atol(argv[2]));
+        return true;
+    }
+    cout << "Usage: main.exe [--rebalance <shards> | --payroll <file> | --snapshot-report | --admin-report [top] |"
+         << " --archive <YYYY-MM-DD> | --generate-ledger-key <path> | --seal-ledger | --verify-ledger |"
+         << " --loadgen [key=value...] | --bench-memory <accounts> | --bench-payroll <transfers>]\n";
+    return true;
+}
+int main(int argc, char* argv[]) {
+    if (runAdminCommand(argc, argv)) {
+        return 0;
+    }
     system("cls");  
     setColor(11); 
     cout << "========================================\n";